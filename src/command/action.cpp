@@ -35,6 +35,8 @@ getDefaultEventsForAction(ActionType at, ::command::CommandContext cc) {
                 return {event::EventType::HART_BEFORE_EXECUTE};
             case ActionType::RESUME:
                 return {event::EventType::HART_BEFORE_EXECUTE};
+            case ActionType::STEP:
+                return {event::EventType::HART_BEFORE_EXECUTE};
             case ActionType::DISASM:
                 return {event::EventType::HART_BEFORE_EXECUTE};
             case ActionType::DUMP:
@@ -43,6 +45,12 @@ getDefaultEventsForAction(ActionType at, ::command::CommandContext cc) {
                 return std::set(allEvents.begin(), allEvents.end());
             case ActionType::SET:
                 return {event::EventType::HART_BEFORE_EXECUTE};
+            case ActionType::SNAPSHOT:
+                return {event::EventType::HART_BEFORE_EXECUTE};
+            case ActionType::RESTORE:
+                return {event::EventType::HART_BEFORE_EXECUTE};
+            case ActionType::DIFF:
+                return {event::EventType::HART_BEFORE_EXECUTE};
             default: return {};
         }
     } else if(cc == command::CommandContext::REPL) {
@@ -65,6 +73,9 @@ void Pause::action([[maybe_unused]] std::ostream* o) {
 void Resume::action([[maybe_unused]] std::ostream* o) {
     if(hs) hs->resume();
 }
+void Step::action([[maybe_unused]] std::ostream* o) {
+    if(hs && expr) hs->step(expr->eval(hs));
+}
 void Disasm::action(std::ostream* o) {
     if(o && hs && expr) {
         auto pc = expr->eval(hs);
@@ -85,6 +96,35 @@ void Set::action([[maybe_unused]] std::ostream* o) {
         expr1->set(hs, expr2);
     }
 }
+// the snapshots taken so far, snapshot n is at n-1
+static std::vector<std::shared_ptr<mem::Snapshot>> snapshots;
+static std::shared_ptr<mem::Snapshot>
+findSnapshot(types::UnsignedInteger number, std::ostream* o) {
+    if(number >= 1 && number <= snapshots.size()) return snapshots[number - 1];
+    if(o) *o << "No snapshot " << std::dec << number << std::endl;
+    return nullptr;
+}
+void Snapshot::action(std::ostream* o) {
+    if(!hs) return;
+    snapshots.push_back(hs->mem().snapshot());
+    if(o) {
+        *o << std::string(indent, ' ') << "Snapshot " << std::dec
+           << snapshots.size() << std::endl;
+    }
+}
+void Restore::action(std::ostream* o) {
+    if(!hs || !expr) return;
+    if(auto s = findSnapshot(expr->eval(hs), o)) hs->mem().restore(*s);
+}
+void Diff::action(std::ostream* o) {
+    if(!o || !hs || !expr) return;
+    if(auto s = findSnapshot(expr->eval(hs), o)) {
+        for(auto page : hs->mem().diff(*s)) {
+            *o << std::string(indent, ' ') << common::Format::doubleword
+               << page << std::endl;
+        }
+    }
+}
 void Dump::action(std::ostream* o) {
     if(o && hs) {
         *o << std::string(indent, ' ');
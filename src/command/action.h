@@ -21,10 +21,14 @@ enum class ActionType {
     STOP,
     PAUSE,
     RESUME,
+    STEP,
     DISASM,
     DUMP,
     WATCH,
     SET,
+    SNAPSHOT,
+    RESTORE,
+    DIFF,
     GROUP,
     NONE,
 };
@@ -154,8 +158,14 @@ class ActionBase {
 MAKE_ACTION_0_ARGS(Stop, STOP)
 MAKE_ACTION_0_ARGS(Pause, PAUSE)
 MAKE_ACTION_0_ARGS(Resume, RESUME)
+MAKE_ACTION_1_ARGS(Step, STEP)
 MAKE_ACTION_1_ARGS(Disasm, DISASM)
 MAKE_ACTION_2_ARGS(Set, SET)
+// memory snapshots, numbered from 1 in the order they are taken. registers
+// are not part of them
+MAKE_ACTION_0_ARGS(Snapshot, SNAPSHOT)
+MAKE_ACTION_1_ARGS(Restore, RESTORE)
+MAKE_ACTION_1_ARGS(Diff, DIFF)
 
 class Dump : public ActionBase {
   public:
@@ -212,6 +222,8 @@ class Watch : public ActionBase {
           actions(actions_begin, actions_end), previous() {}
     virtual ~Watch() = default;
     void action(std::ostream* o = nullptr) override;
+    command::ExprPtr getExpr() { return expr; }
+    std::vector<ActionPtr> getActions() { return actions; }
     static bool classof(const ActionBase* ai) {
         return ai->at == ActionType::WATCH;
     }
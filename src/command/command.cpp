@@ -6,6 +6,9 @@
 #include "hart/isa/inst-execute.h"
 #include "hart/isa/inst.h"
 
+#include <algorithm>
+#include <map>
+
 namespace command {
 
 Command::Command(
@@ -56,7 +59,8 @@ CallbackCommand::CallbackCommand(
     command::ExprPtr condition,
     std::set<event::EventType> events,
     bool useColor)
-    : Command(hs, context, actions, condition, useColor), events(events) {
+    : Command(hs, context, actions, condition, useColor), events(events),
+      default_events(events.empty()) {
     if(this->events.empty()) {
         // no events, use the union of the defaults for the actions
         std::deque<::action::ActionPtr> q(
@@ -82,47 +86,128 @@ CallbackCommand::CallbackCommand(
     }
 }
 
+// true if running the action only prints
+static bool isSideEffectFree(::action::ActionPtr a) {
+    std::vector<::action::ActionPtr> nested;
+    if(a->isa<::action::Dump>() || a->isa<::action::Disasm>()) return true;
+    else if(a->isa<::action::ActionGroup>())
+        nested = a->cast<::action::ActionGroup>()->getActions();
+    else if(a->isa<::action::Watch>())
+        nested = a->cast<::action::Watch>()->getActions();
+    else return false;
+    return std::all_of(nested.begin(), nested.end(), isSideEffectFree);
+}
+
+bool CallbackCommand::installWatchListeners() {
+    // a condition can change without any write, so it has to be checked on
+    // every event
+    if(!default_events || condition) return false;
+
+    command::ExprDependencies deps;
+    std::deque<::action::ActionPtr> q(
+        this->actions.begin(),
+        this->actions.end());
+    while(!q.empty()) {
+        auto a = q.back();
+        q.pop_back();
+        if(a->isa<::action::ActionGroup>()) {
+            auto more_actions =
+                a->cast<::action::ActionGroup>()->getActions();
+            q.insert(q.begin(), more_actions.begin(), more_actions.end());
+        } else if(a->isa<::action::Watch>()) {
+            auto watch = a->cast<::action::Watch>();
+            // filtered listeners fire from inside blocks and native code,
+            // which do not look at the execution state or the register file
+            // until they end. so what the watch does must not change either
+            for(auto sub : watch->getActions()) {
+                if(!isSideEffectFree(sub)) return false;
+            }
+            watch->getExpr()->addDependencies(hs, deps);
+        } else return false;
+    }
+    if(deps.unknown) return false;
+
+    auto hart = hs->getExecutingHart();
+    if(!deps.memory.empty()) {
+        subscribe(hart->hs().mem().addWriteListener(
+            deps.memory,
+            [this](uint64_t, uint64_t, uint64_t, size_t) {
+                this->Command::doit(&std::cout);
+            }));
+    }
+    std::map<isa::rf::RegisterClassType, RegisterClass::Mask> masks;
+    for(auto reg : deps.registers) {
+        masks[reg.rct] |= RegisterClass::Mask(1) << reg.idx;
+    }
+    for(auto [rct, mask] : masks) {
+        subscribe(hart->addRegisterWriteListener(
+            rct,
+            mask,
+            [this](RegisterClass::ClassID, uint64_t, uint64_t, uint64_t) {
+                this->Command::doit(&std::cout);
+            }));
+    }
+    return true;
+}
+
+void CallbackCommand::subscribe(event::ListenerHandle handle) {
+    subscriptions.emplace_back(std::move(handle));
+}
+void CallbackCommand::subscribe(std::vector<event::ListenerHandle> handles) {
+    for(auto& h : handles)
+        subscribe(std::move(h));
+}
+
 void CallbackCommand::install() {
     if(!hs) return;
+    uninstall();
+    if(installWatchListeners()) return;
 // attach to all relevant events
 // use super classes doit
 #define CALLBACK_TO_INSTALL this->Command::doit(&std::cout);
 
+    auto hart = hs->getExecutingHart();
     for(auto event_type : this->events) {
         switch(event_type) {
             case event::EventType::HART_BEFORE_EXECUTE:
-                hs->getExecutingHart()->addBeforeExecuteListener(
-                    [this](hart::HartState&) { CALLBACK_TO_INSTALL });
+                subscribe(hart->addBeforeExecuteListener(
+                    [this](hart::HartState&) { CALLBACK_TO_INSTALL }));
                 break;
             case event::EventType::HART_AFTER_EXECUTE:
-                hs->getExecutingHart()->addAfterExecuteListener(
-                    [this](hart::HartState&) { CALLBACK_TO_INSTALL });
+                subscribe(hart->addAfterExecuteListener(
+                    [this](hart::HartState&) { CALLBACK_TO_INSTALL }));
                 break;
             case event::EventType::MEM_READ:
-                hs->getExecutingHart()->hs().mem().addReadListener(
-                    [this](uint64_t, uint64_t, size_t) { CALLBACK_TO_INSTALL });
+                subscribe(hart->hs().mem().addReadListener(
+                    [this](uint64_t, uint64_t, size_t) {
+                        CALLBACK_TO_INSTALL
+                    }));
                 break;
             case event::EventType::MEM_WRITE:
-                hs->getExecutingHart()->hs().mem().addWriteListener(
+                subscribe(hart->hs().mem().addWriteListener(
                     [this](uint64_t, uint64_t, uint64_t, size_t) {
                         CALLBACK_TO_INSTALL
-                    });
+                    }));
                 break;
             case event::EventType::MEM_ALLOCATION:
-                hs->getExecutingHart()->hs().mem().addAllocationListener(
-                    [this](uint64_t, uint64_t) { CALLBACK_TO_INSTALL });
+                subscribe(hart->hs().mem().addAllocationListener(
+                    [this](uint64_t, uint64_t) { CALLBACK_TO_INSTALL }));
                 break;
             case event::EventType::REG_READ:
-                hs->getExecutingHart()->hs().rf().addReadListener(
-                    [this](std::string, uint64_t, uint64_t) {
+                subscribe(hart->hs().rf().addReadListener(
+                    [this](RegisterClass::ClassID, uint64_t, uint64_t) {
                         CALLBACK_TO_INSTALL
-                    });
+                    }));
                 break;
             case event::EventType::REG_WRITE:
-                hs->getExecutingHart()->hs().rf().addWriteListener(
-                    [this](std::string, uint64_t, uint64_t, uint64_t) {
+                subscribe(hart->hs().rf().addWriteListener(
+                    [this](
+                        RegisterClass::ClassID,
+                        uint64_t,
+                        uint64_t,
+                        uint64_t) {
                         CALLBACK_TO_INSTALL
-                    });
+                    }));
                 break;
             default: std::cerr << "No Event Handler Defined\n";
         }
@@ -130,4 +215,21 @@ void CallbackCommand::install() {
 #undef CALLBACK_TO_INSTALL
 }
 
+void CallbackCommand::uninstall() { subscriptions.clear(); }
+void CallbackCommand::setEnabled(bool enabled) {
+    for(auto& s : subscriptions)
+        s->setEnabled(enabled);
+}
+
+// true if a is a watch or holds one
+static bool containsWatch(::action::ActionPtr a) {
+    if(a->isa<::action::Watch>()) return true;
+    if(!a->isa<::action::ActionGroup>()) return false;
+    auto nested = a->cast<::action::ActionGroup>()->getActions();
+    return std::any_of(nested.begin(), nested.end(), containsWatch);
+}
+bool CallbackCommand::isWatch() const {
+    return std::any_of(actions.begin(), actions.end(), containsWatch);
+}
+
 } // namespace command
@@ -64,11 +64,25 @@ class Command {
     virtual void install() {
         // does nothing in the base case
     }
+    virtual void uninstall() {
+        // does nothing in the base case
+    }
 };
 
 class CallbackCommand : public Command {
   protected:
     std::set<event::EventType> events;
+    // set if events were not given and came from the actions
+    bool default_events;
+    // the listeners from install, removed when the command goes away
+    std::vector<event::Subscription> subscriptions;
+    void subscribe(event::ListenerHandle handle);
+    void subscribe(std::vector<event::ListenerHandle> handles);
+
+    // install listeners for only the writes that can change what the
+    // command watches, returns false if that is not possible or if the
+    // watches do more than print
+    bool installWatchListeners();
 
   public:
     CallbackCommand(
@@ -120,6 +134,11 @@ class CallbackCommand : public Command {
     // override this classes doit, cannot call directly and should do nothing
     virtual void doit([[maybe_unused]] std::ostream* o = nullptr) override {}
     virtual void install() override;
+    virtual void uninstall() override;
+    // a disabled command keeps its listeners but is never run
+    void setEnabled(bool enabled);
+    // true if any of the actions is a watch
+    bool isWatch() const;
 };
 
 } // namespace command
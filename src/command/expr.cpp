@@ -79,6 +79,12 @@ std::string BinaryExpr::getString() const {
 types::SignedInteger BinaryExpr::evalImpl(hart::HartState* hs) const {
     return applyOperator(lhs->eval(hs), op, rhs->eval(hs));
 }
+void BinaryExpr::addDependencies(
+    hart::HartState* hs,
+    ExprDependencies& deps) const {
+    lhs->addDependencies(hs, deps);
+    rhs->addDependencies(hs, deps);
+}
 
 std::string UnaryExpr::getString() const {
     return getOperatorString(op) + expr->getString();
@@ -86,6 +92,10 @@ std::string UnaryExpr::getString() const {
 types::SignedInteger UnaryExpr::evalImpl(hart::HartState* hs) const {
     return applyOperator(op, expr->eval(hs));
 }
+void UnaryExpr::addDependencies(hart::HartState* hs, ExprDependencies& deps)
+    const {
+    expr->addDependencies(hs, deps);
+}
 
 std::string ParenExpr::getString() const {
     return "(" + expr->getString() + ")";
@@ -93,6 +103,10 @@ std::string ParenExpr::getString() const {
 types::SignedInteger ParenExpr::evalImpl(hart::HartState* hs) const {
     return expr->eval(hs);
 }
+void ParenExpr::addDependencies(hart::HartState* hs, ExprDependencies& deps)
+    const {
+    expr->addDependencies(hs, deps);
+}
 
 std::string NumberExpr::getString() const { return std::to_string(number); }
 types::SignedInteger
@@ -118,6 +132,11 @@ types::SignedInteger RegisterExpr::evalImpl(hart::HartState* hs) const {
         ->rawreg(regSym.idx)
         .get();
 }
+void RegisterExpr::addDependencies(
+    [[maybe_unused]] hart::HartState* hs,
+    ExprDependencies& deps) const {
+    deps.registers.push_back(regSym);
+}
 bool RegisterExpr::setImpl(hart::HartState* hs, ExprPtr value) const {
     auto& reg =
         hs->rf().getRegisterClassForType(regSym.rct)->rawreg(regSym.idx);
@@ -130,6 +149,12 @@ std::string PCExpr::getString() const { return "$PC"; }
 types::SignedInteger PCExpr::evalImpl(hart::HartState* hs) const {
     return hs->pc;
 }
+void PCExpr::addDependencies(
+    [[maybe_unused]] hart::HartState* hs,
+    ExprDependencies& deps) const {
+    // the pc changes with every instruction
+    deps.unknown = true;
+}
 bool PCExpr::setImpl(hart::HartState* hs, ExprPtr value) const {
     auto v = value->eval(hs);
     hs->setPC(v);
@@ -150,12 +175,25 @@ types::SignedInteger MemoryExpr::evalImpl(hart::HartState* hs) const {
         "Unable to read memory due to invalid address");
     return 0;
 }
+void MemoryExpr::addDependencies(hart::HartState* hs, ExprDependencies& deps)
+    const {
+    // only a constant address can be known ahead of time
+    ExprDependencies address;
+    expr->addDependencies(hs, address);
+    if(address.unknown || !address.memory.empty() ||
+       !address.registers.empty()) {
+        deps.unknown = true;
+        return;
+    }
+    deps.memory.add(expr->eval(hs), sizeof(types::SignedInteger));
+}
 bool MemoryExpr::setImpl(hart::HartState* hs, ExprPtr value) const {
     auto addr = expr->eval(hs);
     if(addr) {
         auto converted_addr = hs->mem().raw(addr);
         auto v = value->eval(hs);
         *(types::SignedInteger*)(converted_addr) = v;
+        hs->mem().markWritten(addr, sizeof(types::SignedInteger));
     }
     common::debug::logln(
         common::debug::DebugType::EXPR,
@@ -5,10 +5,12 @@
 #include "common/debug.h"
 #include "hart/isa/rf.h"
 #include "hart/types.h"
+#include "mem/address-ranges.h"
 
 #include <memory>
 #include <string>
 #include <variant>
+#include <vector>
 
 namespace hart {
 class HartState;
@@ -52,6 +54,16 @@ class Expr;
 using ExprPtr = std::shared_ptr<Expr>;
 class ParenExpr;
 
+// what the value of an expression depends on, so callers can tell which
+// writes may change it
+struct ExprDependencies {
+    // set if it depends on something that cannot be listed, like the pc or
+    // memory at an address that is only known when it is evaluated
+    bool unknown = false;
+    mem::AddressRanges memory;
+    std::vector<isa::rf::RegisterSymbol> registers;
+};
+
 class Expr {
     friend ParenExpr;
 
@@ -118,6 +130,11 @@ class Expr {
     ExprType getType() const { return et; }
     ExprType getType() { return const_cast<const Expr*>(this)->getType(); }
 
+    // add what this depends on to deps, constants depend on nothing
+    virtual void addDependencies(
+        [[maybe_unused]] hart::HartState* hs,
+        [[maybe_unused]] ExprDependencies& deps) const {}
+
     virtual bool isLValue() const { return false; }
 
     template <typename U> bool isa() { return U::classof(this); }
@@ -142,6 +159,8 @@ class BinaryExpr : public Expr {
     BinaryExpr(ExprPtr lhs, ExprOperatorType op, ExprPtr rhs)
         : Expr(ExprType::BINARY), lhs(lhs), op(op), rhs(rhs) {}
 
+    virtual void
+    addDependencies(hart::HartState* hs, ExprDependencies& deps) const override;
     virtual std::string getString() const override;
 
     static bool classof(const Expr* e) {
@@ -163,6 +182,8 @@ class UnaryExpr : public Expr {
         : Expr(ExprType::UNARY), op(op), expr(expr) {}
     virtual ~UnaryExpr() = default;
 
+    virtual void
+    addDependencies(hart::HartState* hs, ExprDependencies& deps) const override;
     virtual std::string getString() const override;
 
     static bool classof(const Expr* e) {
@@ -183,6 +204,8 @@ class ParenExpr : public Expr {
     ParenExpr(ExprPtr expr) : Expr(ExprType::PAREN), expr(expr) {}
     virtual ~ParenExpr() = default;
 
+    virtual void
+    addDependencies(hart::HartState* hs, ExprDependencies& deps) const override;
     virtual std::string getString() const override;
 
     virtual bool isLValue() const override { return this->expr->isLValue(); }
@@ -242,6 +265,8 @@ class RegisterExpr : public Expr {
         : Expr(ExprType::REGISTER), name(name), regSym(regSym) {}
     virtual ~RegisterExpr() = default;
 
+    virtual void
+    addDependencies(hart::HartState* hs, ExprDependencies& deps) const override;
     virtual std::string getString() const override;
 
     virtual bool isLValue() const override { return true; }
@@ -259,6 +284,8 @@ class PCExpr : public Expr {
     PCExpr() : Expr(ExprType::PC) {}
     virtual ~PCExpr() = default;
 
+    virtual void
+    addDependencies(hart::HartState* hs, ExprDependencies& deps) const override;
     virtual std::string getString() const override;
 
     virtual bool isLValue() const override { return true; }
@@ -277,6 +304,8 @@ class MemoryExpr : public Expr {
     MemoryExpr(ExprPtr expr) : Expr(ExprType::MEMORY), expr(expr) {}
     virtual ~MemoryExpr() = default;
 
+    virtual void
+    addDependencies(hart::HartState* hs, ExprDependencies& deps) const override;
     virtual std::string getString() const override;
 
     virtual bool isLValue() const override { return true; }
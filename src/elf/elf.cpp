@@ -121,6 +121,18 @@ std::string elf::File::getString(uint64_t offset) {
     return "";
 }
 
+std::vector<char> elf::File::getSectionContents(const std::string& name) {
+    for(auto sh : shs) {
+        if(sh.sh_type == 0x8 /*SHT_NOBITS*/) continue;
+        if(getSectionHeaderString(sh.sh_name) != name) continue;
+        std::vector<char> contents(sh.sh_size);
+        ifs.seekg(sh.sh_offset);
+        ifs.read(contents.data(), sh.sh_size);
+        return contents;
+    }
+    return {};
+}
+
 void elf::File::buildMemoryImage(mem::MemoryImage& m) {
     // for each loadable segment
     for(auto ph : phs) {
@@ -137,14 +149,13 @@ void elf::File::buildMemoryImage(mem::MemoryImage& m) {
                    (sh.sh_type == 0x8 /*SHT_NOBITS*/ &&
                     sh.sh_offset >= ph.p_offset &&
                     sh.sh_offset <= ph.p_offset + ph.p_filesz)) {
-                    // if NOBITS, set to 0
-                    if(sh.sh_type == 0x8 /*SHT_NOBITS*/) {
-                        std::memset(m.raw(sh.sh_addr), 0, sh.sh_size);
-                    }
-                    // otherwise copy section to memory
-                    else {
+                    // NOBITS is already 0, newly allocated memory is zeroed
+                    // and left untouched so it is never backed if unused
+                    if(sh.sh_type != 0x8 /*SHT_NOBITS*/) {
+                        std::vector<char> contents(sh.sh_size);
                         ifs.seekg(sh.sh_offset);
-                        ifs.read((char*)m.raw(sh.sh_addr), sh.sh_size);
+                        ifs.read(contents.data(), sh.sh_size);
+                        m.writeBlock(sh.sh_addr, contents.data(), sh.sh_size);
                     }
                 }
             }
@@ -6,6 +6,7 @@
 #include <cstdint>
 #include <cstring>
 #include <fstream>
+#include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -115,6 +116,8 @@ class File {
 
     void buildMemoryImage(mem::MemoryImage&);
     uint64_t getStartAddress();
+    // raw contents of the named section, empty if there is no such section
+    std::vector<char> getSectionContents(const std::string& name);
 
     std::unordered_map<uint64_t, std::string> getSymbolTable();
     std::unordered_map<std::string, uint64_t> getSymbolToAddressMap();
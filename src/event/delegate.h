@@ -0,0 +1,104 @@
+#ifndef ZIRCON_EVENT_DELEGATE_H_
+#define ZIRCON_EVENT_DELEGATE_H_
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace event {
+
+template <typename Signature> class Delegate;
+
+// a callable stored inline, like a std::function that never allocates.
+// callables bigger than CAPACITY are rejected at compile time, capture a
+// pointer to anything larger
+template <typename R, typename... Args> class Delegate<R(Args...)> {
+  public:
+    static constexpr size_t CAPACITY = 64;
+
+  private:
+    enum class Operation { COPY, MOVE, DESTROY };
+
+    alignas(std::max_align_t) unsigned char storage[CAPACITY];
+    R (*invoker)(void*, Args...) = nullptr;
+    void (*manager)(Operation, void*, void*) = nullptr;
+
+    template <typename F> static R invoke(void* f, Args... args) {
+        return (*static_cast<F*>(f))(std::forward<Args>(args)...);
+    }
+    template <typename F>
+    static void manage(Operation op, void* dst, void* src) {
+        switch(op) {
+            case Operation::COPY:
+                new(dst) F(*static_cast<const F*>(src));
+                break;
+            case Operation::MOVE:
+                new(dst) F(std::move(*static_cast<F*>(src)));
+                break;
+            case Operation::DESTROY: static_cast<F*>(dst)->~F(); break;
+        }
+    }
+    void reset() {
+        if(manager) manager(Operation::DESTROY, storage, nullptr);
+        invoker = nullptr;
+        manager = nullptr;
+    }
+
+  public:
+    Delegate() = default;
+    template <
+        typename F,
+        typename = std::enable_if_t<
+            !std::is_same_v<std::decay_t<F>, Delegate> &&
+            std::is_invocable_r_v<R, std::decay_t<F>&, Args...>>>
+    Delegate(F&& f) {
+        using Stored = std::decay_t<F>;
+        static_assert(
+            sizeof(Stored) <= CAPACITY &&
+                alignof(Stored) <= alignof(std::max_align_t),
+            "callable is too big to be stored in a Delegate");
+        new(storage) Stored(std::forward<F>(f));
+        invoker = &invoke<Stored>;
+        manager = &manage<Stored>;
+    }
+    Delegate(const Delegate& other)
+        : invoker(other.invoker), manager(other.manager) {
+        if(manager)
+            manager(
+                Operation::COPY,
+                storage,
+                const_cast<unsigned char*>(other.storage));
+    }
+    Delegate(Delegate&& other) noexcept
+        : invoker(other.invoker), manager(other.manager) {
+        if(manager) manager(Operation::MOVE, storage, other.storage);
+        other.reset();
+    }
+    Delegate& operator=(const Delegate& other) {
+        if(this != &other) {
+            reset();
+            new(this) Delegate(other);
+        }
+        return *this;
+    }
+    Delegate& operator=(Delegate&& other) noexcept {
+        if(this != &other) {
+            reset();
+            new(this) Delegate(std::move(other));
+        }
+        return *this;
+    }
+    ~Delegate() { reset(); }
+
+    R operator()(Args... args) const {
+        return invoker(
+            const_cast<unsigned char*>(storage),
+            std::forward<Args>(args)...);
+    }
+    explicit operator bool() const { return invoker != nullptr; }
+};
+
+} // namespace event
+
+#endif
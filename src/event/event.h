@@ -1,6 +1,9 @@
 #ifndef ZIRCON_EVENT_EVENT_H_
 #define ZIRCON_EVENT_EVENT_H_
 
+#include "delegate.h"
+#include "listener-list.h"
+
 #include <algorithm>
 #include <array>
 #include <functional>
@@ -22,12 +25,15 @@ class EventInterface {
   public:
 };
 
+// callbacks are stored inline and called in place, so firing an event never
+// allocates. callers that have to do work to build the arguments should check
+// empty() first
 template <typename... Types> class Event : public EventInterface {
   public:
-    using callback_type = std::function<void(Types...)>;
+    using callback_type = Delegate<void(Types...)>;
 
   private:
-    std::vector<callback_type> callbacks;
+    ListenerList<callback_type> callbacks;
 
   public:
     // void Event() {
@@ -39,11 +45,12 @@ template <typename... Types> class Event : public EventInterface {
     // }
     void operator()(Types... args) { call(args...); }
     void call(Types... args) {
-        for(auto c : callbacks) {
-            c(args...);
-        }
+        callbacks.forEach([&](const callback_type& c) { c(args...); });
+    }
+    ListenerHandle addListener(callback_type c) {
+        return callbacks.add(std::move(c));
     }
-    void addListener(callback_type c) { callbacks.push_back(c); }
+    bool empty() const { return callbacks.empty(); }
 };
 
 // class EventInterface {
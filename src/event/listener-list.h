@@ -0,0 +1,227 @@
+#ifndef ZIRCON_EVENT_LISTENER_LIST_H_
+#define ZIRCON_EVENT_LISTENER_LIST_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace event {
+
+namespace internal {
+// what a handle needs from the list its listener is in
+class ListenerOwner {
+  public:
+    virtual void remove(uint64_t id) = 0;
+    virtual void setEnabled(uint64_t id, bool enabled) = 0;
+    virtual bool isEnabled(uint64_t id) const = 0;
+
+  protected:
+    ~ListenerOwner() = default;
+};
+} // namespace internal
+
+// refers to one listener in a ListenerList. handles are cheap to copy, and do
+// nothing once the listener or the list it was in is gone. like adding
+// listeners, this should only be done while the hart is not running or from
+// the hart's own thread
+class ListenerHandle {
+  private:
+    std::weak_ptr<internal::ListenerOwner*> owner;
+    uint64_t id = 0;
+
+  public:
+    ListenerHandle() = default;
+    ListenerHandle(std::weak_ptr<internal::ListenerOwner*> owner, uint64_t id)
+        : owner(std::move(owner)), id(id) {}
+
+    void remove() {
+        if(auto o = owner.lock()) (*o)->remove(id);
+        owner.reset();
+    }
+    // a disabled listener stays in its list but is never called, and does
+    // not count as listening
+    void enable() { setEnabled(true); }
+    void disable() { setEnabled(false); }
+    void setEnabled(bool enabled) {
+        if(auto o = owner.lock()) (*o)->setEnabled(id, enabled);
+    }
+    bool isEnabled() const {
+        auto o = owner.lock();
+        return o && (*o)->isEnabled(id);
+    }
+};
+
+// removes its listener when it goes away
+class Subscription {
+  private:
+    ListenerHandle handle;
+
+  public:
+    Subscription() = default;
+    Subscription(ListenerHandle handle) : handle(std::move(handle)) {}
+    Subscription(const Subscription&) = delete;
+    Subscription(Subscription&& other) noexcept
+        : handle(std::exchange(other.handle, {})) {}
+    Subscription& operator=(const Subscription&) = delete;
+    Subscription& operator=(Subscription&& other) noexcept {
+        if(this != &other) {
+            handle.remove();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    ~Subscription() { handle.remove(); }
+
+    ListenerHandle* operator->() { return &handle; }
+    const ListenerHandle* operator->() const { return &handle; }
+    // stop owning the listener, it then stays until its list goes away
+    ListenerHandle release() { return std::exchange(handle, {}); }
+};
+
+// listeners that can be removed or disabled through a ListenerHandle.
+// listeners may add or remove listeners while being called, the list is only
+// changed once nothing is iterating over it. listeners added then are first
+// called the next time
+template <typename T> class ListenerList : internal::ListenerOwner {
+  private:
+    struct Entry {
+        // 0 once removed
+        uint64_t id;
+        bool enabled;
+        T value;
+    };
+    std::vector<Entry> entries;
+    // added while iterating, growing entries then would move the listener
+    // being called
+    std::vector<Entry> pending;
+    size_t enabled_count = 0;
+    uint64_t next_id = 1;
+    unsigned iterating = 0;
+    bool has_removed = false;
+    // handles point at this through self, so they notice when the list is
+    // gone. it follows the list when it is moved
+    std::shared_ptr<internal::ListenerOwner*> self;
+
+    Entry* find(uint64_t id) {
+        for(auto& e : entries) {
+            if(e.id == id) return &e;
+        }
+        for(auto& e : pending) {
+            if(e.id == id) return &e;
+        }
+        return nullptr;
+    }
+    const Entry* find(uint64_t id) const {
+        return const_cast<ListenerList*>(this)->find(id);
+    }
+    void compact() {
+        entries.erase(
+            std::remove_if(
+                entries.begin(),
+                entries.end(),
+                [](const Entry& e) { return e.id == 0; }),
+            entries.end());
+        has_removed = false;
+    }
+    // catch up on what was deferred while iterating
+    void settle() {
+        if(has_removed) compact();
+        for(auto& e : pending) {
+            if(e.id != 0) entries.push_back(std::move(e));
+        }
+        pending.clear();
+    }
+    void remove(uint64_t id) override {
+        auto e = find(id);
+        if(!e) return;
+        if(e->enabled) enabled_count--;
+        e->id = 0;
+        e->enabled = false;
+        has_removed = true;
+        if(iterating == 0) compact();
+        changed();
+    }
+    void setEnabled(uint64_t id, bool enabled) override {
+        auto e = find(id);
+        if(!e || e->enabled == enabled) return;
+        e->enabled = enabled;
+        if(enabled) enabled_count++;
+        else enabled_count--;
+        changed();
+    }
+    bool isEnabled(uint64_t id) const override {
+        auto e = find(id);
+        return e && e->enabled;
+    }
+
+  protected:
+    // called after a listener is added, removed, enabled, or disabled
+    virtual void changed() {}
+
+  public:
+    ListenerList() = default;
+    ListenerList(const ListenerList&) = delete;
+    ListenerList(ListenerList&& other) noexcept
+        : entries(std::move(other.entries)), pending(std::move(other.pending)),
+          enabled_count(std::exchange(other.enabled_count, 0)),
+          next_id(other.next_id), iterating(0),
+          has_removed(std::exchange(other.has_removed, false)),
+          self(std::move(other.self)) {
+        if(self) *self = static_cast<internal::ListenerOwner*>(this);
+    }
+    ListenerList& operator=(const ListenerList&) = delete;
+    ListenerList& operator=(ListenerList&& other) noexcept {
+        if(this != &other) {
+            entries = std::move(other.entries);
+            pending = std::move(other.pending);
+            enabled_count = std::exchange(other.enabled_count, 0);
+            next_id = other.next_id;
+            has_removed = std::exchange(other.has_removed, false);
+            self = std::move(other.self);
+            if(self) *self = static_cast<internal::ListenerOwner*>(this);
+        }
+        return *this;
+    }
+    virtual ~ListenerList() = default;
+
+    ListenerHandle add(T value) {
+        if(!self) {
+            internal::ListenerOwner* owner = this;
+            self = std::make_shared<internal::ListenerOwner*>(owner);
+        }
+        auto id = next_id++;
+        if(iterating == 0) entries.push_back({id, true, std::move(value)});
+        else pending.push_back({id, true, std::move(value)});
+        enabled_count++;
+        changed();
+        return ListenerHandle(self, id);
+    }
+    // true if no listener is enabled
+    bool empty() const { return enabled_count == 0; }
+
+    // calls f(listener) for every enabled listener, in the order they were
+    // added
+    template <typename F> void forEach(F&& f) {
+        struct Guard {
+            ListenerList* list;
+            ~Guard() {
+                if(--list->iterating == 0) list->settle();
+            }
+        } guard{this};
+        iterating++;
+        for(size_t i = 0; i < entries.size(); i++) {
+            if(entries[i].enabled) f(entries[i].value);
+        }
+    }
+    template <typename F> void forEach(F&& f) const {
+        for(const auto& e : entries) {
+            if(e.enabled) f(e.value);
+        }
+    }
+};
+
+} // namespace event
+
+#endif
@@ -0,0 +1,119 @@
+#include "block-cache.h"
+
+#include <algorithm>
+
+namespace hart {
+
+// custom instructions that only compute a result, they can stay in the middle
+// of a block
+static bool isStraightLineCustom(isa::inst::Opcode op) {
+    return op == isa::inst::Opcode::rv64i_slli ||
+           op == isa::inst::Opcode::rv64i_srli ||
+           op == isa::inst::Opcode::rv64i_srai ||
+           op == isa::inst::Opcode::rv32i_fence;
+}
+
+// true for instructions that may leave the block
+static bool endsBlock(isa::inst::Opcode op) {
+    return op == isa::inst::Opcode::UNKNOWN || op.isBType() || op.isJType() ||
+           op == isa::inst::Opcode::rv32i_jalr ||
+           (op.isCustomType() && !isStraightLineCustom(op));
+}
+
+std::unique_ptr<TranslatedBlock>
+BlockCache::translate(mem::MemoryImage& mem, types::Address pc) {
+    auto block = std::make_unique<TranslatedBlock>();
+    block->start = pc;
+
+    types::Address addr = pc;
+    types::Address previous = pc;
+    while(block->insts.size() < MAX_BLOCK_INSTRUCTIONS) {
+        auto ptr = mem.fetch(addr);
+        if(ptr == nullptr) break;
+        auto inst = isa::inst::predecodeInstruction(*ptr);
+        block->insts.push_back(inst);
+        previous = addr;
+        addr += inst.opcode.getInstructionSize();
+        if(endsBlock(inst.opcode)) break;
+    }
+    if(block->insts.empty()) return nullptr;
+
+    block->end = addr;
+    const auto& last = block->insts.back();
+    if(last.opcode.isBType()) {
+        block->successors[0].pc = last.imm + previous;
+        block->successors[1].pc = addr;
+    } else if(last.opcode == isa::inst::Opcode::rv32i_jal) {
+        block->successors[0].pc = last.imm + previous;
+    } else if(!endsBlock(last.opcode)) {
+        block->successors[0].pc = addr;
+    }
+    block->insts.push_back(isa::inst::blockEnd());
+    mem.addCodeRange(block->start, block->end);
+    constexpr auto PAGE_SIZE = mem::MemoryImage::CODE_PAGE_SIZE;
+    for(auto page = block->start & ~(PAGE_SIZE - 1); page < block->end;
+        page += PAGE_SIZE) {
+        page_blocks[page].push_back(block->start);
+    }
+    return block;
+}
+
+void BlockCache::dropWrittenPages() {
+    for(auto page : written_pages) {
+        auto it = page_blocks.find(page);
+        if(it == page_blocks.end()) continue;
+        for(auto start : it->second) {
+            auto block = blocks.find(start);
+            if(block == blocks.end()) continue;
+            auto& entry = lookup_table[(start >> 2) & (LOOKUP_SIZE - 1)];
+            if(entry == block->second.get()) entry = nullptr;
+            blocks.erase(block);
+        }
+        page_blocks.erase(it);
+    }
+    written_pages.clear();
+    // links may point at blocks that are gone
+    unlink();
+}
+
+TranslatedBlock* BlockCache::lookup(mem::MemoryImage& mem, types::Address pc) {
+    if(mem.getCodeGeneration() != code_generation) {
+        dropWrittenPages();
+        code_generation = mem.getCodeGeneration();
+    }
+
+    auto& entry = lookup_table[(pc >> 2) & (LOOKUP_SIZE - 1)];
+    if(entry && entry->start == pc) return entry;
+
+    auto it = blocks.find(pc);
+    if(it == blocks.end()) {
+        auto block = translate(mem, pc);
+        if(!block) return nullptr;
+        it = blocks.emplace(pc, std::move(block)).first;
+    }
+    entry = it->second.get();
+    return entry;
+}
+
+void BlockCache::link(TranslatedBlock& from, TranslatedBlock& next) {
+    for(auto& s : from.successors) {
+        if(s.pc == next.start) s.block = &next;
+    }
+}
+
+void BlockCache::unlink() {
+    for(auto& [pc, block] : blocks) {
+        for(auto& s : block->successors) {
+            s.block = nullptr;
+        }
+    }
+}
+
+void BlockCache::flush() {
+    blocks.clear();
+    page_blocks.clear();
+    written_pages.clear();
+    std::fill(lookup_table.begin(), lookup_table.end(), nullptr);
+}
+
+} // namespace hart
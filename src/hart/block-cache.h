@@ -0,0 +1,124 @@
+#ifndef ZIRCON_HART_BLOCK_CACHE_H_
+#define ZIRCON_HART_BLOCK_CACHE_H_
+
+#include "types.h"
+
+#include "isa/inst-execute.h"
+#include "mem/memory-image.h"
+
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace hart {
+
+namespace jit {
+struct Context;
+}
+
+// a run of straight line instructions, translated once and then executed as a
+// whole with isa::inst::executeBlock
+struct TranslatedBlock {
+    types::Address start;
+    // address just past the last instruction
+    types::Address end;
+    // ends with isa::inst::blockEnd()
+    std::vector<isa::inst::DecodedInstruction> insts;
+
+    // successors known when the block is translated, the taken and not taken
+    // targets of a branch, the target of a jal, or the next instruction when
+    // the block was cut short. these are linked directly to the translated
+    // block once it exists, so hot loops go from block to block without a
+    // lookup
+    static constexpr types::Address NO_SUCCESSOR = 1;
+    struct Successor {
+        types::Address pc = NO_SUCCESSOR;
+        TranslatedBlock* block = nullptr;
+    };
+    std::array<Successor, 2> successors;
+
+    // the number of instructions before pc, which is how many ran when the
+    // block was left early with pc next. all of them if pc is not in the
+    // block
+    size_t countBefore(types::Address pc) const {
+        auto at = start;
+        for(size_t i = 0; i + 1 < insts.size(); i++) {
+            if(at == pc) return i;
+            at += insts[i].opcode.getInstructionSize();
+        }
+        return insts.size() - 1;
+    }
+
+    // the linked block for pc, nullptr if pc is not a linked successor
+    TranslatedBlock* getSuccessor(types::Address pc) const {
+        for(const auto& s : successors) {
+            if(s.pc == pc) return s.block;
+        }
+        return nullptr;
+    }
+
+    // native code from the jit, only valid while native_epoch matches the
+    // epoch of the jit that compiled it
+    void (*native)(jit::Context*) = nullptr;
+    uint32_t native_epoch = 0;
+    uint32_t executions = 0;
+    bool native_unsupported = false;
+
+    // whether an execute hook wants one of the instructions, only valid while
+    // hook_epoch matches the hart's
+    uint32_t hook_epoch = 0;
+    bool hooked = false;
+};
+
+// translated blocks, keyed by their start address
+// translations are made from the contents of memory at the time, so when the
+// memory image reports a write to a page of translated code every block made
+// from that page is dropped
+class BlockCache {
+  public:
+    static constexpr size_t LOOKUP_SIZE = 1 << 12;
+    static constexpr size_t MAX_BLOCK_INSTRUCTIONS = 64;
+
+  private:
+    std::unordered_map<types::Address, std::unique_ptr<TranslatedBlock>>
+        blocks;
+    // direct mapped in front of blocks, so most lookups avoid hashing
+    std::vector<TranslatedBlock*> lookup_table;
+    uint64_t code_generation;
+    // the start of every block made from each page, a block that crosses
+    // pages is listed under both
+    std::unordered_map<types::Address, std::vector<types::Address>>
+        page_blocks;
+    // pages written since the last lookup, blocks may still be running when
+    // a write is reported so they are dropped on the next lookup
+    std::vector<types::Address> written_pages;
+
+    std::unique_ptr<TranslatedBlock>
+    translate(mem::MemoryImage& mem, types::Address pc);
+    void dropWrittenPages();
+
+  public:
+    BlockCache()
+        : blocks(), lookup_table(LOOKUP_SIZE), code_generation(0),
+          page_blocks(), written_pages() {}
+
+    // returns nullptr if there is no memory at pc
+    TranslatedBlock* lookup(mem::MemoryImage& mem, types::Address pc);
+    // true if memory holding translated code has been written since the last
+    // lookup, any links between blocks are stale
+    bool isStale(const mem::MemoryImage& mem) const {
+        return mem.getCodeGeneration() != code_generation;
+    }
+    // link from to next if next starts at one of its static successors
+    void link(TranslatedBlock& from, TranslatedBlock& next);
+    // remove every link between blocks
+    void unlink();
+    // the page has been written, drop its blocks on the next lookup
+    void invalidatePage(types::Address page) { written_pages.push_back(page); }
+    void flush();
+};
+
+} // namespace hart
+
+#endif
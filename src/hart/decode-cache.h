@@ -0,0 +1,52 @@
+#ifndef ZIRCON_HART_DECODE_CACHE_H_
+#define ZIRCON_HART_DECODE_CACHE_H_
+
+#include "types.h"
+
+#include "isa/inst-execute.h"
+
+#include <cassert>
+#include <vector>
+
+namespace hart {
+
+// direct mapped cache of predecoded instructions, keyed by pc
+// entries are tagged with both the pc and the instruction word they were
+// decoded from, so a write to the text section (from the program, a syscall,
+// or the ishell) is caught the next time that pc is fetched and the stale
+// entry is decoded again
+class DecodeCache {
+  public:
+    static constexpr size_t DEFAULT_SIZE = 1 << 14;
+
+  private:
+    struct Entry {
+        types::Address pc;
+        isa::inst::DecodedInstruction inst;
+    };
+    std::vector<Entry> entries;
+    size_t mask;
+
+    // instructions are at least 2 byte aligned, so an odd pc is never valid
+    static constexpr types::Address INVALID_PC = 1;
+
+  public:
+    DecodeCache(size_t size = DEFAULT_SIZE)
+        : entries(size, Entry{INVALID_PC, {}}), mask(size - 1) {
+        assert(size != 0 && (size & mask) == 0 && "size must be a power of 2");
+    }
+
+    const isa::inst::DecodedInstruction&
+    lookup(types::Address pc, types::InstructionWord bits) {
+        auto& e = entries[(pc >> 2) & mask];
+        if(e.pc != pc || e.inst.bits != bits) {
+            e.pc = pc;
+            e.inst = isa::inst::predecodeInstruction(bits);
+        }
+        return e.inst;
+    }
+};
+
+} // namespace hart
+
+#endif
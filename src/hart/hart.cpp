@@ -5,8 +5,10 @@
 #include "isa/inst.h"
 #include "isa/instruction_match.h"
 #include "isa/rf.h"
+#include "mem/fault-guard.h"
 #include "syscall/syscall.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -16,18 +18,13 @@
 namespace hart {
 
 Hart::Hart(std::shared_ptr<mem::MemoryImage> m)
-    : hs_(std::make_unique<HartState>(this, m)) {}
-
-bool Hart::shouldHalt() {
-    // if pc is beyond the bounds of memory , return true
-    if(hs().mem().raw(hs().pc) == nullptr) return true;
-    // if the instruction just executed was a jmp to itself, halt
-    auto inst = hs().getInstWord();
-    auto op = isa::inst::decodeInstruction(inst);
-    auto jmp_target =
-        instruction::signext64<20>(instruction::getJTypeImm(inst)) + hs().pc;
-    return (
-        op == isa::inst::Opcode::rv32i_jal && jmp_target == hs().pc.previous());
+    : hs_(std::make_unique<HartState>(this, m)) {
+    hs().mem().addCodeWriteListener(
+        [this](types::Address page) { block_cache.invalidatePage(page); });
+    // the JIT remembers host buffers of regions that may be gone
+    hs().mem().addDeallocationListener([this](types::Address, uint64_t) {
+        if(jit_) jit_->resetMemoryCaches();
+    });
 }
 
 types::Address Hart::alloc(size_t n) {
@@ -37,9 +34,7 @@ types::Address Hart::alloc(size_t n) {
     return ptr;
 }
 void Hart::copyToHart(void* src, types::Address dst, size_t n) {
-    for(size_t i = 0; i < n; i++) {
-        hs().mem().byte(dst + i) = ((char*)src)[i];
-    }
+    hs().mem().writeBlock(dst, src, n);
 }
 
 enum class AUXVecType : uint64_t {
@@ -145,15 +140,22 @@ void Hart::init_stack(
         "stack_end",
         hs().getMemLocation("stack_start") + stack_size);
     hs().mem().allocate(hs().getMemLocation("stack_start"), stack_size);
+    // mmap places memory in the 16GiB below the stack, like linux does
+    hs().setMemLocation("mmap_end", hs().getMemLocation("stack_start"));
+    hs().setMemLocation(
+        "mmap_start",
+        hs().getMemLocation("mmap_end") - 0x400000000);
     auto sp = hs().getMemLocation("stack_end");
 
     // auxvec
     common::ordered_map<AUXVecType, uint64_t> auxvec;
     auxvec.insert_or_assign(AUXVecType::AT_PAGESZ, 4096);
     auto rand_addr = alloc(16);
-    for(auto i = 0; i < 16; i++) {
-        hs().mem().byte(rand_addr + i) = uint8_t(rand());
+    uint8_t rand_bytes[16];
+    for(auto& b : rand_bytes) {
+        b = uint8_t(rand());
     }
+    copyToHart(rand_bytes, rand_addr, sizeof(rand_bytes));
     auxvec.insert_or_assign(AUXVecType::AT_RANDOM, rand_addr);
     auxvec.insert_or_assign(AUXVecType::AT_NULL, 0);
 
@@ -212,27 +214,151 @@ void Hart::init(
     init_stack(argv, envp);
 
     execution_thread = std::thread(&Hart::execute, this);
+    hs().executing_thread = execution_thread.get_id();
+}
+
+bool Hart::hasListeners() {
+    return !event_before_execute.empty() || !event_after_execute.empty() ||
+           hs().rf().hasListeners() || hs().mem().hasListeners();
+}
+
+void Hart::executeInstrumented() {
+    for(size_t i = 0; i < QUANTUM && !hs().state_changed; i++) {
+        // running off the end of memory halts the hart
+        auto ptr = hs().mem().fetch(hs().pc);
+        if(ptr == nullptr) {
+            hs().stop();
+            return;
+        }
+        event_before_execute(hs());
+        auto& inst = decode_cache.lookup(hs().pc, *ptr);
+        bool hooked = hooked_opcodes.contains(inst.opcode);
+        if(hooked) fireHooks(before_execute_hooks, inst.opcode);
+        isa::inst::executeInstruction(inst, hs());
+        if(!instruction_counts.empty()) instruction_counts[inst.opcode]++;
+        if(hooked) fireHooks(after_execute_hooks, inst.opcode);
+        event_after_execute(hs());
+        if(hs().isStepping() && --hs().steps_remaining == 0 && hs().isRunning())
+            hs().pause();
+    }
+}
+
+bool Hart::enableJit(bool verify) {
+    if(!jit::Jit::isSupported()) return false;
+    jit_ = std::make_unique<jit::Jit>(verify);
+    return true;
+}
+
+void Hart::executeBlocks() {
+    if(hs().mem().hasFlatBackend()) {
+        // let the host catch bad accesses instead of checking each one
+        mem::FaultGuard guard(hs().mem());
+        runBlocks();
+    } else {
+        runBlocks();
+    }
+    // everything outside of the block loop expects the register file to be
+    // up to date
+    if(jit_) jit_->sync(hs());
+}
+
+void Hart::runBlocks() {
+    auto block = block_cache.lookup(hs().mem(), hs().pc);
+    if(block == nullptr) {
+        hs().stop();
+        return;
+    }
+    if(jit_) jit_->resetMemoryCaches();
+    size_t executed = 0;
+    while(1) {
+        size_t ran = 0;
+        if(isHooked(*block)) {
+            if(jit_) jit_->sync(hs());
+            ran = executeHookedBlock(*block);
+        } else if(!jit_ || !(ran = jit_->execute(*block, hs()))) {
+            if(jit_) jit_->sync(hs());
+            ran = isa::inst::executeBlock(block->insts.data(), hs());
+        }
+        executed += ran;
+        if(!instruction_counts.empty()) countBlock(*block, ran);
+
+        if(hs().state_changed || executed >= QUANTUM) {
+            // the ishell may change anything while the hart is not running,
+            // so start over from lookups when it resumes
+            if(!hs().isRunning()) block_cache.unlink();
+            return;
+        }
+        // listeners are only added while the hart is not running, so they
+        // do not have to be checked here
+        if(block_cache.isStale(hs().mem())) return;
+
+        auto next = block->getSuccessor(hs().pc);
+        if(next == nullptr) {
+            next = block_cache.lookup(hs().mem(), hs().pc);
+            if(next == nullptr) {
+                hs().stop();
+                return;
+            }
+            if(jit_) jit_->resetMemoryCaches();
+            block_cache.link(*block, *next);
+        }
+        block = next;
+    }
+}
+
+bool Hart::isHooked(TranslatedBlock& block) {
+    if(hooked_opcodes.empty()) return false;
+    if(block.hook_epoch != hook_epoch) {
+        // the last instruction is blockEnd()
+        block.hooked = std::any_of(
+            block.insts.begin(),
+            block.insts.end() - 1,
+            [this](const isa::inst::DecodedInstruction& inst) {
+                return hooked_opcodes.contains(inst.opcode);
+            });
+        block.hook_epoch = hook_epoch;
+    }
+    return block.hooked;
+}
+
+size_t Hart::executeHookedBlock(const TranslatedBlock& block) {
+    const auto code_generation = hs().mem().getCodeGeneration();
+    // the last instruction is blockEnd()
+    size_t i = 0;
+    for(; i + 1 < block.insts.size(); i++) {
+        const auto& inst = block.insts[i];
+        bool hooked = hooked_opcodes.contains(inst.opcode);
+        if(hooked) fireHooks(before_execute_hooks, inst.opcode);
+        isa::inst::executeInstruction(inst, hs());
+        if(hooked) fireHooks(after_execute_hooks, inst.opcode);
+        // a hook may have paused the hart, and a store may have changed the
+        // rest of the block
+        if(hs().state_changed ||
+           hs().mem().getCodeGeneration() != code_generation)
+            return i + 1;
+    }
+    return i;
 }
 
 void Hart::execute() {
     sync_point.wait();
     while(1) {
         if(hs().isRunning()) {
+            hs().state_changed = false;
             try {
-                event_before_execute(hs());
-                auto inst = hs().getInstWord();
-                isa::inst::executeInstruction(inst, hs());
-                event_after_execute(hs());
-
-                if(shouldHalt()) hs().stop();
+                if(hasListeners() || hs().isStepping()) executeInstrumented();
+                else executeBlocks();
             } catch(const std::exception& e) {
                 std::cerr << "Exception Occurred: " << e.what() << std::endl;
                 hs().setExecutionState(ExecutionState::INVALID_STATE);
             }
         } else if(hs().isPaused()) {
-            // do nothing
-            std::this_thread::yield();
+            // let the shell in, then sleep until the hart is resumed,
+            // stepped, or stopped
+            hs().park();
+            hs().waitWhile(ExecutionState::PAUSED);
         } else {
+            hs().park();
             break;
         }
     }
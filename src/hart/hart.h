@@ -2,16 +2,22 @@
 #ifndef ZIRCON_HART_HART_H_
 #define ZIRCON_HART_HART_H_
 
+#include "block-cache.h"
+#include "decode-cache.h"
 #include "hartstate.h"
 #include "types.h"
 
 #include "common/ordered_map.h"
 #include "common/threading/syncpoint.h"
 #include "event/event.h"
+#include "isa/inst.h"
 #include "isa/rf.h"
+#include "jit/jit.h"
 #include "mem/memory-image.h"
 
+#include <memory>
 #include <thread>
+#include <vector>
 
 namespace hart {
 
@@ -29,6 +35,9 @@ struct IllegalInstructionException : public HartException {
 class Hart {
   private:
     std::unique_ptr<HartState> hs_;
+    DecodeCache decode_cache;
+    BlockCache block_cache;
+    std::unique_ptr<jit::Jit> jit_;
 
   private:
     types::Address alloc(size_t n);
@@ -38,7 +47,30 @@ class Hart {
     void init_stack(
         std::vector<std::string> argv = {},
         common::ordered_map<std::string, std::string> envp = {});
-    bool shouldHalt();
+    // listeners need to see every instruction, so when there are any the hart
+    // steps one instruction at a time instead of running whole blocks
+    bool hasListeners();
+    // both run at most a quantum of instructions, the execution state set
+    // from other threads is only polled between quanta
+    void executeInstrumented();
+    // runs blocks until the hart stops running, the quantum is used up, or
+    // blocks can no longer be used, following links between blocks where it
+    // can
+    void executeBlocks();
+    void runBlocks();
+    // true if the block holds an instruction an execute hook wants to see
+    bool isHooked(TranslatedBlock& block);
+    // runs a hooked block one instruction at a time, firing the hooks for the
+    // instructions they want. returns the number of instructions that ran
+    size_t executeHookedBlock(const TranslatedBlock& block);
+    // executed instructions by opcode, empty unless counting is enabled
+    std::vector<uint64_t> instruction_counts;
+    // count the first executed instructions of the block, the rest did not
+    // run when it was left early
+    void countBlock(const TranslatedBlock& block, size_t executed) {
+        for(size_t i = 0; i < executed; i++)
+            instruction_counts[block.insts[i].opcode]++;
+    }
     // Subsystem: hart
     // Description: Fires just before current instruction is executed
     // Parameters: (Hart State object)
@@ -48,26 +80,101 @@ class Hart {
     // Parameters: (Hart State object)
     event::Event<HartState&> event_after_execute;
 
+    // execute listeners that only fire for some opcodes. unlike the events
+    // above they do not force the hart to step one instruction at a time,
+    // blocks without a hooked instruction still run whole
+    struct ExecuteHook {
+        isa::inst::OpcodeSet opcodes;
+        event::Event<HartState&>::callback_type callback;
+    };
+    // works out hooked_opcodes again whenever its hooks change
+    class HookList : public event::ListenerList<ExecuteHook> {
+      private:
+        Hart* hart;
+        void changed() override { hart->updateHookedOpcodes(); }
+
+      public:
+        HookList(Hart* hart) : hart(hart) {}
+    };
+    HookList before_execute_hooks{this};
+    HookList after_execute_hooks{this};
+    // every opcode some enabled hook wants
+    isa::inst::OpcodeSet hooked_opcodes;
+    // bumped whenever the hooks change, so blocks are checked again
+    uint32_t hook_epoch = 0;
+    void updateHookedOpcodes() {
+        hooked_opcodes = {};
+        auto add = [this](const ExecuteHook& h) {
+            hooked_opcodes |= h.opcodes;
+        };
+        before_execute_hooks.forEach(add);
+        after_execute_hooks.forEach(add);
+        hook_epoch++;
+    }
+    void fireHooks(HookList& hooks, isa::inst::Opcode opcode) {
+        hooks.forEach([this, opcode](const ExecuteHook& h) {
+            if(h.opcodes.contains(opcode)) h.callback(hs());
+        });
+    }
+
   public:
+    // instructions run between polls of the execution state
+    static constexpr size_t QUANTUM = 1 << 14;
+
     Hart(std::shared_ptr<mem::MemoryImage> m);
     void init(
         std::vector<std::string> argv = {},
         common::ordered_map<std::string, std::string> envp = {});
 
-    template <typename T> void addBeforeExecuteListener(T&& arg) {
-        event_before_execute.addListener(std::forward<T>(arg));
+    // listeners can be removed or disabled through the handles these return.
+    // the hart goes back to running blocks by the next quantum once none of
+    // the listeners that need it to step are left
+    template <typename T>
+    event::ListenerHandle addBeforeExecuteListener(T&& arg) {
+        return event_before_execute.addListener(std::forward<T>(arg));
     }
-    template <typename T> void addAfterExecuteListener(T&& arg) {
-        event_after_execute.addListener(std::forward<T>(arg));
+    template <typename T>
+    event::ListenerHandle addAfterExecuteListener(T&& arg) {
+        return event_after_execute.addListener(std::forward<T>(arg));
     }
-    template <typename T> void addRegisterReadListener(T&& arg) {
-        hs().rf().addReadListener(std::forward<T>(arg));
+    // only fire for instructions whose opcode is in opcodes
+    template <typename T>
+    event::ListenerHandle
+    addBeforeExecuteListener(isa::inst::OpcodeSet opcodes, T&& arg) {
+        return before_execute_hooks.add({opcodes, std::forward<T>(arg)});
     }
-    template <typename T> void addRegisterWriteListener(T&& arg) {
-        hs().rf().addWriteListener(std::forward<T>(arg));
+    template <typename T>
+    event::ListenerHandle
+    addAfterExecuteListener(isa::inst::OpcodeSet opcodes, T&& arg) {
+        return after_execute_hooks.add({opcodes, std::forward<T>(arg)});
+    }
+    template <typename... T>
+    decltype(auto) addRegisterReadListener(T&&... args) {
+        return hs().rf().addReadListener(std::forward<T>(args)...);
+    }
+    template <typename... T>
+    decltype(auto) addRegisterWriteListener(T&&... args) {
+        return hs().rf().addWriteListener(std::forward<T>(args)...);
     }
     HartState& hs() { return *hs_; }
 
+    // count the executed instructions by opcode. blocks are counted as a
+    // whole once they have run, so unlike an execute listener this does not
+    // make the hart step one instruction at a time. must be called before
+    // execution starts
+    void enableInstructionCounts() {
+        instruction_counts.assign(isa::inst::Opcode::size(), 0);
+    }
+    // indexed by opcode, empty if counting is not enabled
+    const std::vector<uint64_t>& getInstructionCounts() const {
+        return instruction_counts;
+    }
+
+    // compile hot blocks to native code, checking every native block against
+    // the interpreter if verify is set. must be called before execution
+    // starts, returns false if the host is not supported
+    bool enableJit(bool verify = false);
+
     void wait_till_done() {
         sync_point.wait();
         execution_thread.join();
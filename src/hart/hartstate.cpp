@@ -1,15 +1,16 @@
 #include "hartstate.h"
 
 namespace hart {
-// use raw(addr) so we don't log mem access
+// use fetch(addr) so we don't log mem access
 types::InstructionWord HartState::getInstWord() const {
-    auto ptr = mem().raw(pc);
-    return *((types::InstructionWord*)ptr);
+    return *mem().fetch(pc);
 }
 
 HartState::HartState(Hart* hart, std::shared_ptr<mem::MemoryImage> m)
     : hart(hart), rf_(std::make_unique<isa::rf::RegisterFile>()), memories_(),
-      execution_state(ExecutionState::STOPPED), elfSymbols() {
+      local_mem(m.get()), lock_es(), signal_es(),
+      execution_state(ExecutionState::STOPPED), steps_remaining(0),
+      executing_thread(), state_changed(false), elfSymbols() {
     // insert memory image for address space 0
     this->memories_.insert_or_assign(0, m);
 }
@@ -10,6 +10,7 @@
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <thread>
 #include <unordered_map>
 
 namespace command {
@@ -47,16 +48,32 @@ class HartState {
 
     // address space 0 points to local_mem;
     std::unordered_map<types::Address, MemoryPair> memories_;
+    // address space 0, kept apart so the common case skips the map
+    mem::MemoryImage* local_mem;
 
-    // std::mutex lock_es;
-    // std::condition_variable signal_es;
+    // guards changes to execution_state so threads can sleep until it changes
+    std::mutex lock_es;
+    std::condition_variable signal_es;
     std::atomic<ExecutionState> execution_state;
+    // instructions left to run before the hart pauses again, 0 when it is not
+    // stepping
+    std::atomic<uint64_t> steps_remaining;
+    // the thread executing the hart. it only polls execution_state between
+    // quanta, so changes made from that thread, by an instruction or a
+    // listener, set state_changed to end the quantum right away
+    std::thread::id executing_thread;
+    bool state_changed;
+    // set by the executing thread once it has noticed that the hart is not
+    // running and has left the block loop, cleared whenever the hart runs
+    // again. guarded by lock_es
+    bool parked = false;
 
     std::unordered_map<std::string, uint64_t> elfSymbols;
 
   public:
     isa::rf::RegisterFile& rf() const { return *rf_; }
     mem::MemoryImage& mem(types::Address addressSpace = 0) const {
+        if(addressSpace == 0) return *local_mem;
         // TODO: need to handle case where address space not in memories
         if(auto mem_it = memories_.find(addressSpace);
            mem_it != memories_.end()) {
@@ -120,16 +137,11 @@ class HartState {
 
       private:
         T current_pc;
-        T previous_pc;
 
       public:
         T read() { return current_pc; }
         T read() const { return current_pc; }
-        void write(T v) {
-            previous_pc = current_pc;
-            current_pc = v;
-        }
-        T previous() { return previous_pc; }
+        void write(T v) { current_pc = v; }
         operator T() { return read(); }
         operator T() const { return read(); }
         PCProxy operator=(T v) {
@@ -148,7 +160,7 @@ class HartState {
     // address in memory of current instruction
     PCProxy pc;
 
-    // use raw(addr) so we don't log mem access
+    // use fetch(addr) so we don't log mem access
     types::InstructionWord getInstWord() const;
 
     HartState(Hart* hart, std::shared_ptr<mem::MemoryImage> m);
@@ -166,7 +178,17 @@ class HartState {
     }
     void stop() { setExecutionState(ExecutionState::STOPPED); }
     void pause() { setExecutionState(ExecutionState::PAUSED); }
-    void resume() { setExecutionState(ExecutionState::RUNNING); }
+    void resume() {
+        steps_remaining = 0;
+        setExecutionState(ExecutionState::RUNNING);
+    }
+    // run n instructions and then pause
+    void step(uint64_t n = 1) {
+        if(n == 0) return;
+        steps_remaining = n;
+        setExecutionState(ExecutionState::RUNNING);
+    }
+    bool isStepping() { return steps_remaining != 0; }
     ExecutionState getExecutionState() { return execution_state; }
     bool isRunning() { return execution_state == ExecutionState::RUNNING; }
     bool isPaused() { return execution_state == ExecutionState::PAUSED; }
@@ -176,11 +198,40 @@ class HartState {
     }
 
     void setExecutionState(ExecutionState es) {
+        std::unique_lock lk(lock_es);
         if(!isValidExecutionStateTransition(es)) {
             es = ExecutionState::INVALID_STATE;
             common::debug::logln("Hart is now in an invalid execution state");
         }
         execution_state = es;
+        if(es == ExecutionState::RUNNING) parked = false;
+        if(std::this_thread::get_id() == executing_thread)
+            state_changed = true;
+        lk.unlock();
+        signal_es.notify_all();
+    }
+    // sleep until the execution state is no longer es
+    void waitWhile(ExecutionState es) {
+        std::unique_lock lk(lock_es);
+        signal_es.wait(lk, [this, es] { return execution_state != es; });
+    }
+    // called by the executing thread when it is not executing anything
+    void park() {
+        std::unique_lock lk(lock_es);
+        parked = execution_state != ExecutionState::RUNNING;
+        lk.unlock();
+        signal_es.notify_all();
+    }
+    // the hart only notices that it should stop running at the end of a
+    // block, so other threads must wait for it before touching its state.
+    // sleep until it has parked, returns false if it was set running again
+    // first
+    bool waitUntilParked() {
+        std::unique_lock lk(lock_es);
+        signal_es.wait(lk, [this] {
+            return parked || execution_state == ExecutionState::RUNNING;
+        });
+        return parked;
     }
 
   private:
@@ -203,6 +254,29 @@ class HartState {
     }
 };
 
+// what instruction bodies see of a HartState when nothing is listening.
+// registers and memory are accessed directly, so no events fire
+class BareHartState {
+  private:
+    HartState& state;
+    isa::rf::BareRegisterFile rf_;
+    mem::MemoryImage::BareView mem_;
+
+  public:
+    HartState::PCProxy& pc;
+
+    BareHartState(HartState& state)
+        : state(state), rf_(state.rf()), mem_(state.mem()), pc(state.pc) {}
+
+    BareHartState& operator()() { return *this; }
+    isa::rf::BareRegisterFile& rf() { return rf_; }
+    mem::MemoryImage::BareView& mem() { return mem_; }
+    void stop() { state.stop(); }
+    void pause() { state.pause(); }
+    // anything else, like system calls, gets the whole HartState
+    operator HartState&() { return state; }
+};
+
 } // namespace hart
 
 #endif
@@ -10,7 +10,10 @@ namespace isa {
 namespace inst {
 
 namespace internal {
-extern void executeInstruction(uint32_t bits, hart::HartState& hs);
+extern DecodedInstruction predecodeInstruction(uint32_t bits);
+extern DecodedInstruction blockEnd();
+extern size_t
+executeBlock(const DecodedInstruction* block, hart::HartState& hs);
 extern std::string disassemble(uint32_t bits, uint32_t pc, bool color);
 
 extern std::string colorReset(bool doColor);
@@ -21,12 +24,23 @@ extern std::string colorNumber(bool doColor);
 
 } // namespace internal
 
+DecodedInstruction predecodeInstruction(uint32_t bits) {
+    return internal::predecodeInstruction(bits);
+}
+
 void executeInstruction(uint32_t bits, hart::HartState& hs) {
-    Opcode op = decodeInstruction(bits);
-    switch(op) {
+    executeInstruction(predecodeInstruction(bits), hs);
+}
+void executeInstruction(const DecodedInstruction& inst, hart::HartState& hs) {
+    switch(inst.opcode) {
         default: break;
     }
-    internal::executeInstruction(bits, hs);
+    inst.execute(inst, hs);
+}
+
+DecodedInstruction blockEnd() { return internal::blockEnd(); }
+size_t executeBlock(const DecodedInstruction* block, hart::HartState& hs) {
+    return internal::executeBlock(block, hs);
 }
 
 std::string disassemble(uint32_t bits, uint32_t pc, bool color) {
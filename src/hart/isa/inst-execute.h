@@ -3,15 +3,49 @@
 
 #include "inst.h"
 
-#include "hart/hart.h"
+#include "hart/types.h"
 
 #include <string>
 
+namespace hart {
+class HartState;
+}
+
 namespace isa {
 
 namespace inst {
 
+// an instruction with all of its fields extracted ahead of time, so executing
+// it does not have to decode the raw bits again
+struct DecodedInstruction {
+    using ExecutionFunction =
+        void (*)(const DecodedInstruction&, hart::HartState&);
+
+    types::InstructionWord bits;
+    Opcode opcode;
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;
+    // the sign extended immediate for the instruction format, 0 if there is
+    // no immediate
+    types::SignedInteger imm;
+    ExecutionFunction execute;
+};
+
+DecodedInstruction predecodeInstruction(uint32_t bits);
+
 void executeInstruction(uint32_t bits, hart::HartState& hs);
+void executeInstruction(const DecodedInstruction& inst, hart::HartState& hs);
+
+// a block is straight line code, an array of instructions that ends with
+// blockEnd(). only the last real instruction in a block may change the pc
+// other than moving to the next instruction
+DecodedInstruction blockEnd();
+// execute every instruction in the block, stopping early if a store writes to
+// memory holding translated code. no register or memory events fire, so this
+// is only for when nothing is listening. returns the number of instructions
+// that ran
+size_t executeBlock(const DecodedInstruction* block, hart::HartState& hs);
 std::string disassemble(uint32_t bits, uint32_t pc = 0, bool color = false);
 
 }; // namespace inst
@@ -1,7 +1,9 @@
 #include "inst.h"
 
+#include "common/utils.h"
 #include "hart/hart.h"
 
+#include <functional>
 #include <sstream>
 
 #include "instruction_match.h"
@@ -22,7 +24,6 @@ extern uint64_t getFunct7FieldFromTable(Opcode op);
 extern uint64_t getFunct3FieldFromTable(Opcode op);
 
 extern Opcode decodeInstruction(uint32_t bits);
-extern void executeInstruction(uint32_t bits, hart::HartState& hs);
 extern std::string disassemble(uint32_t bits, uint32_t pc, bool color);
 
 extern std::string colorReset(bool doColor);
@@ -75,6 +76,46 @@ uint64_t Opcode::getFunct3Field(Opcode op) {
     return internal::getFunct3FieldFromTable(op);
 }
 
+// major opcodes, the low 7 bits of an instruction
+static OpcodeSet withOpcodeField(std::initializer_list<uint64_t> fields) {
+    return OpcodeSet::matching([fields](Opcode op) {
+        if(op == Opcode::UNKNOWN) return false;
+        for(auto f : fields) {
+            if(Opcode::getOpcodeField(op) == f) return true;
+        }
+        return false;
+    });
+}
+OpcodeSet OpcodeSet::branches() { return withOpcodeField({0b1100011}); }
+OpcodeSet OpcodeSet::jumps() {
+    return withOpcodeField({0b1101111, 0b1100111});
+}
+OpcodeSet OpcodeSet::loads() {
+    return withOpcodeField({0b0000011, 0b0101111});
+}
+OpcodeSet OpcodeSet::stores() {
+    return withOpcodeField({0b0100011, 0b0101111});
+}
+OpcodeSet OpcodeSet::system() { return withOpcodeField({0b1110011}); }
+
+OpcodeSet OpcodeSet::lookupName(std::string name) {
+    name = common::utils::tolower(name);
+    if(name == "branch") return branches();
+    if(name == "jump") return jumps();
+    if(name == "load") return loads();
+    if(name == "store") return stores();
+    if(name == "system") return system();
+    if(name == "r-type") return matching(std::mem_fn(&Opcode::isRType));
+    if(name == "i-type") return matching(std::mem_fn(&Opcode::isIType));
+    if(name == "s-type") return matching(std::mem_fn(&Opcode::isSType));
+    if(name == "b-type") return matching(std::mem_fn(&Opcode::isBType));
+    if(name == "u-type") return matching(std::mem_fn(&Opcode::isUType));
+    if(name == "j-type") return matching(std::mem_fn(&Opcode::isJType));
+    auto op = Opcode::lookupName(name);
+    if(op == Opcode::UNKNOWN) return {};
+    return {op};
+}
+
 Opcode decodeInstruction(uint32_t bits) {
     Opcode op = internal::decodeInstruction(bits);
     if(op != Opcode::UNKNOWN) return op;
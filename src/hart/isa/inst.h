@@ -1,6 +1,9 @@
 #ifndef ZIRCON_HART_ISA_INST_H_
 #define ZIRCON_HART_ISA_INST_H_
 
+#include <bitset>
+#include <cstdint>
+#include <initializer_list>
 #include <string>
 
 namespace isa {
@@ -43,7 +46,18 @@ struct Opcode {
     static uint64_t getFunct7Field(Opcode op);
     static uint64_t getFunct3Field(Opcode op);
 
-    static constexpr size_t size();
+    static constexpr size_t size() {
+        return 1
+#define R_TYPE(prefix, name, ...) +1
+#define I_TYPE(prefix, name, ...) +1
+#define S_TYPE(prefix, name, ...) +1
+#define B_TYPE(prefix, name, ...) +1
+#define U_TYPE(prefix, name, ...) +1
+#define J_TYPE(prefix, name, ...) +1
+#define CUSTOM(prefix, name, ...) +1
+#include "defs/instructions.inc"
+            ;
+    }
 
     bool isRType() const;
     bool isIType() const;
@@ -56,6 +70,52 @@ struct Opcode {
     int getInstructionSize() const;
 };
 
+// a set of opcodes, used to pick the instructions an execute hook runs for
+class OpcodeSet {
+    std::bitset<Opcode::size()> opcodes;
+
+  public:
+    OpcodeSet() = default;
+    OpcodeSet(std::initializer_list<Opcode> ops) {
+        for(auto op : ops)
+            insert(op);
+    }
+    // every opcode op where pred(op) is true
+    template <typename Pred> static OpcodeSet matching(Pred pred) {
+        OpcodeSet s;
+        for(Opcode::ValueType op = 0; op < Opcode::size(); op++) {
+            if(pred(Opcode(op))) s.insert(op);
+        }
+        return s;
+    }
+    // classes of instructions, by their major opcode
+    // loads and stores both include the atomics
+    static OpcodeSet branches();
+    static OpcodeSet jumps();
+    static OpcodeSet loads();
+    static OpcodeSet stores();
+    static OpcodeSet system();
+    // one of the classes above ("branch", "jump", "load", "store",
+    // "system"), an instruction format ("R-type" through "J-type"), or the
+    // name of a single instruction. empty if name is none of those
+    static OpcodeSet lookupName(std::string name);
+
+    OpcodeSet& insert(Opcode op) {
+        opcodes.set(op);
+        return *this;
+    }
+    bool contains(Opcode op) const {
+        return op < opcodes.size() && opcodes[op];
+    }
+    bool empty() const { return opcodes.none(); }
+
+    OpcodeSet& operator|=(const OpcodeSet& other) {
+        opcodes |= other.opcodes;
+        return *this;
+    }
+    OpcodeSet operator|(OpcodeSet other) const { return other |= *this; }
+};
+
 Opcode decodeInstruction(uint32_t bits);
 
 }; // namespace inst
@@ -4,25 +4,16 @@
 #include "common/utils.h"
 #include "hart/syscall/syscall.h"
 
+#include <algorithm>
+#include <array>
 #include <sstream>
+#include <vector>
 
+#include "inst-execute.h"
 #include "instruction_match.h"
 
 namespace isa {
 namespace inst {
-constexpr size_t Opcode::size() {
-    return 1
-#define R_TYPE(prefix, name, ...) +1
-#define I_TYPE(prefix, name, ...) +1
-#define S_TYPE(prefix, name, ...) +1
-#define B_TYPE(prefix, name, ...) +1
-#define U_TYPE(prefix, name, ...) +1
-#define J_TYPE(prefix, name, ...) +1
-#define CUSTOM(prefix, name, ...) +1
-#include "defs/instructions.inc"
-        ;
-}
-
 bool Opcode::isRType() const {
     switch(this->_value) {
         default: return false;
@@ -255,55 +246,148 @@ uint64_t getOpcodePrecedence(Opcode op) {
     }
 #include "defs/instructions.inc"
 
-Opcode decodeInstruction(uint32_t bits) {
-    Opcode matched = Opcode::UNKNOWN;
-#define R_TYPE(prefix, name, opcode, funct7, funct3, execution, precedence)    \
-    if(instruction::getOpcode(bits) == opcode &&                               \
-       instruction::getFunct7(bits) == funct7 &&                               \
-       instruction::getFunct3(bits) == funct3 &&                               \
-       (matched == Opcode::UNKNOWN ||                                          \
-        precedence < getOpcodePrecedence(matched))) {                          \
-        matched = Opcode::prefix##_##name;                                     \
+namespace {
+// decode table built once from the instruction definitions
+// the major opcode selects an entry, and funct3 and funct7 are only looked at
+// when an instruction with that opcode depends on them. every entry already
+// has precedence resolved, so decoding is a fixed number of lookups no matter
+// how many instructions are defined
+// custom instructions have no fixed format, their matchers are only tried for
+// the major opcodes they are defined for
+class DecodeTable {
+    static constexpr int16_t NO_TABLE = -1;
+    struct Entry {
+        Opcode op;
+        // index of the next level table, NO_TABLE if op is the final answer
+        int16_t next = NO_TABLE;
+        bool has_custom = false;
+    };
+    std::array<Entry, 128> opcodes;
+    std::vector<std::array<Entry, 8>> funct3s;
+    std::vector<std::array<Opcode, 128>> funct7s;
+
+    enum class Fields { BY_OPCODE, BY_FUNCT3, BY_FUNCT7 };
+    struct Candidate {
+        Opcode op;
+        Fields fields;
+        uint32_t funct3;
+        uint32_t funct7;
+    };
+
+    // same rules as the linear decoder, lowest precedence wins and ties go
+    // to the first definition
+    template <typename Pred>
+    static Opcode resolve(const std::vector<Candidate>& candidates, Pred pred) {
+        Opcode matched = Opcode::UNKNOWN;
+        for(const auto& c : candidates) {
+            if(pred(c) && (matched == Opcode::UNKNOWN ||
+                           getOpcodePrecedence(c.op) <
+                               getOpcodePrecedence(matched))) {
+                matched = c.op;
+            }
+        }
+        return matched;
     }
-#define I_TYPE(prefix, name, opcode, funct3, execution, precedence)            \
+
+    // a matching custom instruction always wins, and if several match the
+    // last one defined is used
+    static Opcode decodeCustom(uint32_t bits) {
+        Opcode matched = Opcode::UNKNOWN;
+#define CUSTOM(prefix, name, opcode, matcher, printer, execution, precedence)  \
     if(instruction::getOpcode(bits) == opcode &&                               \
-       instruction::getFunct3(bits) == funct3 &&                               \
-       (matched == Opcode::UNKNOWN ||                                          \
-        precedence < getOpcodePrecedence(matched))) {                          \
-        matched = Opcode::prefix##_##name;                                     \
+       prefix##_##name##_matcher_func(bits))                                   \
+        matched = Opcode::prefix##_##name;
+#include "defs/instructions.inc"
+        return matched;
     }
+
+  public:
+    DecodeTable() {
+        std::array<std::vector<Candidate>, 128> candidates;
+#define R_TYPE(prefix, name, opcode, funct7, funct3, execution, precedence)    \
+    candidates[opcode].push_back(                                              \
+        {Opcode::prefix##_##name, Fields::BY_FUNCT7, funct3, funct7});
+#define I_TYPE(prefix, name, opcode, funct3, execution, precedence)            \
+    candidates[opcode].push_back(                                              \
+        {Opcode::prefix##_##name, Fields::BY_FUNCT3, funct3, 0});
 #define S_TYPE(prefix, name, opcode, funct3, execution, precedence)            \
-    if(instruction::getOpcode(bits) == opcode &&                               \
-       instruction::getFunct3(bits) == funct3 &&                               \
-       (matched == Opcode::UNKNOWN ||                                          \
-        precedence < getOpcodePrecedence(matched))) {                          \
-        matched = Opcode::prefix##_##name;                                     \
-    }
+    candidates[opcode].push_back(                                              \
+        {Opcode::prefix##_##name, Fields::BY_FUNCT3, funct3, 0});
 #define B_TYPE(prefix, name, opcode, funct3, execution, precedence)            \
-    if(instruction::getOpcode(bits) == opcode &&                               \
-       instruction::getFunct3(bits) == funct3 &&                               \
-       (matched == Opcode::UNKNOWN ||                                          \
-        precedence < getOpcodePrecedence(matched))) {                          \
-        matched = Opcode::prefix##_##name;                                     \
-    }
+    candidates[opcode].push_back(                                              \
+        {Opcode::prefix##_##name, Fields::BY_FUNCT3, funct3, 0});
 #define U_TYPE(prefix, name, opcode, execution, precedence)                    \
-    if(instruction::getOpcode(bits) == opcode &&                               \
-       (matched == Opcode::UNKNOWN ||                                          \
-        precedence < getOpcodePrecedence(matched))) {                          \
-        matched = Opcode::prefix##_##name;                                     \
-    }
+    candidates[opcode].push_back(                                              \
+        {Opcode::prefix##_##name, Fields::BY_OPCODE, 0, 0});
 #define J_TYPE(prefix, name, opcode, execution, precedence)                    \
-    if(instruction::getOpcode(bits) == opcode &&                               \
-       (matched == Opcode::UNKNOWN ||                                          \
-        precedence < getOpcodePrecedence(matched))) {                          \
-        matched = Opcode::prefix##_##name;                                     \
-    }
+    candidates[opcode].push_back(                                              \
+        {Opcode::prefix##_##name, Fields::BY_OPCODE, 0, 0});
+#include "defs/instructions.inc"
 #define CUSTOM(prefix, name, opcode, matcher, printer, execution, precedence)  \
-    if(prefix##_##name##_matcher_func(bits)) matched = Opcode::prefix##_##name;
+    opcodes[opcode].has_custom = true;
 #include "defs/instructions.inc"
 
-    return matched;
-}
+        for(size_t opcode = 0; opcode < opcodes.size(); opcode++) {
+            const auto& cands = candidates[opcode];
+            auto& entry = opcodes[opcode];
+            entry.op = resolve(cands, [](const Candidate& c) {
+                return c.fields == Fields::BY_OPCODE;
+            });
+            bool needsFunct3 =
+                std::any_of(cands.begin(), cands.end(), [](const auto& c) {
+                    return c.fields != Fields::BY_OPCODE;
+                });
+            if(!needsFunct3) continue;
+
+            entry.next = funct3s.size();
+            auto& funct3_table = funct3s.emplace_back();
+            for(uint32_t funct3 = 0; funct3 < 8; funct3++) {
+                auto& f3entry = funct3_table[funct3];
+                f3entry.op = resolve(cands, [funct3](const Candidate& c) {
+                    return c.fields == Fields::BY_OPCODE ||
+                           (c.fields == Fields::BY_FUNCT3 &&
+                            c.funct3 == funct3);
+                });
+                bool needsFunct7 = std::any_of(
+                    cands.begin(),
+                    cands.end(),
+                    [funct3](const auto& c) {
+                        return c.fields == Fields::BY_FUNCT7 &&
+                               c.funct3 == funct3;
+                    });
+                if(!needsFunct7) continue;
+
+                f3entry.next = funct7s.size();
+                auto& funct7_table = funct7s.emplace_back();
+                for(uint32_t funct7 = 0; funct7 < 128; funct7++) {
+                    funct7_table[funct7] =
+                        resolve(cands, [funct3, funct7](const Candidate& c) {
+                            return c.fields == Fields::BY_OPCODE ||
+                                   (c.funct3 == funct3 &&
+                                    (c.fields == Fields::BY_FUNCT3 ||
+                                     c.funct7 == funct7));
+                        });
+                }
+            }
+        }
+    }
+
+    Opcode decode(uint32_t bits) const {
+        const auto& entry = opcodes[instruction::getOpcode(bits)];
+        if(entry.has_custom) {
+            auto custom = decodeCustom(bits);
+            if(custom != Opcode::UNKNOWN) return custom;
+        }
+        if(entry.next == NO_TABLE) return entry.op;
+        const auto& f3entry = funct3s[entry.next][instruction::getFunct3(bits)];
+        if(f3entry.next == NO_TABLE) return f3entry.op;
+        return funct7s[f3entry.next][instruction::getFunct7(bits)];
+    }
+};
+static const DecodeTable DECODE_TABLE;
+} // namespace
+
+Opcode decodeInstruction(uint32_t bits) { return DECODE_TABLE.decode(bits); }
 
 // use precedence, rather than prefix, to distinguish
 // this is SLOW
@@ -334,31 +418,161 @@ const Opcode getOpcodeFromTable(std::string arg) {
     return matched;
 }
 
-void executeInstruction(uint32_t bits, hart::HartState& hs) {
-    Opcode opcode = decodeInstruction(bits);
-    switch(opcode) {
-        default: throw hart::IllegalInstructionException(bits);
-
-#define SIMPLE_EXECUTION(prefix, name, execution)                              \
-    case Opcode::prefix##_##name: do { execution;                              \
+// each instruction gets its own execution function, reading its register and
+// immediate fields from the predecoded instruction instead of the raw bits.
+// they are instantiated for hart::HartState, which fires events, and for
+// hart::BareHartState, which does not
+#define DECODED_EXECUTION_FUNCTION(prefix, name, execution)                    \
+    template <typename HartStateType>                                          \
+    void prefix##_##name##_execution_func(                                     \
+        const DecodedInstruction& decoded,                                     \
+        HartStateType& hs) {                                                   \
+        [[maybe_unused]] uint32_t bits = decoded.bits;                         \
+        [[maybe_unused]] Opcode opcode = decoded.opcode;                       \
+        do {                                                                   \
+            execution;                                                         \
         } while(0);                                                            \
-        break;
-#define R_TYPE(prefix, name, opcode, funct7, funct3, execution, precedence)    \
-    SIMPLE_EXECUTION(prefix, name, execution)
-#define I_TYPE(prefix, name, opcode, funct3, execution, precedence)            \
-    SIMPLE_EXECUTION(prefix, name, execution)
-#define S_TYPE(prefix, name, opcode, funct3, execution, precedence)            \
-    SIMPLE_EXECUTION(prefix, name, execution)
-#define B_TYPE(prefix, name, opcode, funct3, execution, precedence)            \
-    SIMPLE_EXECUTION(prefix, name, execution)
-#define U_TYPE(prefix, name, opcode, execution, precedence)                    \
-    SIMPLE_EXECUTION(prefix, name, execution)
-#define J_TYPE(prefix, name, opcode, execution, precedence)                    \
-    SIMPLE_EXECUTION(prefix, name, execution)
+    }
+
+#define DECODED_EXECUTION(format, prefix, name, execution)                     \
+    DECODED_EXECUTION_FUNCTION(prefix, name, execution)
+#include "decoded-instructions.inc"
+#undef DECODED_EXECUTION
+
+#define RD (decoded.rd)
+#define RS1 (decoded.rs1)
+#define RS2 (decoded.rs2)
 #define CUSTOM(prefix, name, opcode, matcher, printer, execution, precedence)  \
-    SIMPLE_EXECUTION(prefix, name, execution)
+    DECODED_EXECUTION_FUNCTION(prefix, name, execution)
 #include "defs/instructions.inc"
-    }
+
+#undef DECODED_EXECUTION_FUNCTION
+
+void UNKNOWN_execution_func(
+    const DecodedInstruction& decoded,
+    [[maybe_unused]] hart::HartState& hs) {
+    throw hart::IllegalInstructionException(decoded.bits);
+}
+
+DecodedInstruction::ExecutionFunction EXECUTION_FUNCTION_TABLE[] = {
+    UNKNOWN_execution_func,
+#define EXECUTION_FUNCTION(prefix, name)                                       \
+    prefix##_##name##_execution_func<hart::HartState>,
+#define R_TYPE(prefix, name, ...) EXECUTION_FUNCTION(prefix, name)
+#define I_TYPE(prefix, name, ...) EXECUTION_FUNCTION(prefix, name)
+#define S_TYPE(prefix, name, ...) EXECUTION_FUNCTION(prefix, name)
+#define B_TYPE(prefix, name, ...) EXECUTION_FUNCTION(prefix, name)
+#define U_TYPE(prefix, name, ...) EXECUTION_FUNCTION(prefix, name)
+#define J_TYPE(prefix, name, ...) EXECUTION_FUNCTION(prefix, name)
+#define CUSTOM(prefix, name, ...) EXECUTION_FUNCTION(prefix, name)
+#include "defs/instructions.inc"
+#undef EXECUTION_FUNCTION
+};
+
+DecodedInstruction predecodeInstruction(uint32_t bits) {
+    DecodedInstruction inst;
+    inst.bits = bits;
+    inst.opcode = ::isa::inst::decodeInstruction(bits);
+    inst.rd = instruction::getRd(bits);
+    inst.rs1 = instruction::getRs1(bits);
+    inst.rs2 = instruction::getRs2(bits);
+    if(inst.opcode.isIType())
+        inst.imm = instruction::signext64<12>(instruction::getITypeImm(bits));
+    else if(inst.opcode.isSType())
+        inst.imm = instruction::signext64<12>(instruction::getSTypeImm(bits));
+    else if(inst.opcode.isBType())
+        inst.imm = instruction::signext64<13>(instruction::getBTypeImm(bits));
+    else if(inst.opcode.isUType())
+        inst.imm = instruction::signext64<32>(instruction::getUTypeImm(bits));
+    else if(inst.opcode.isJType())
+        inst.imm = instruction::signext64<20>(instruction::getJTypeImm(bits));
+    else inst.imm = 0;
+    inst.execute = EXECUTION_FUNCTION_TABLE[inst.opcode];
+    return inst;
+}
+
+// one past the last opcode, only used to mark the end of a block
+static constexpr Opcode::ValueType BLOCK_END = Opcode::size();
+
+DecodedInstruction blockEnd() {
+    DecodedInstruction inst{};
+    inst.opcode = BLOCK_END;
+    return inst;
+}
+
+// runs a block with threaded dispatch, each instruction jumps directly to the
+// code for the next one rather than returning to a loop. the instruction
+// bodies are the same ones used by the execution functions, given a
+// hart::BareHartState so no events fire
+size_t executeBlock(const DecodedInstruction* block, hart::HartState& state) {
+    static const void* const handlers[] = {
+        &&UNKNOWN_handler,
+#define R_TYPE(prefix, name, ...) &&prefix##_##name##_handler,
+#define I_TYPE(prefix, name, ...) &&prefix##_##name##_handler,
+#define S_TYPE(prefix, name, ...) &&prefix##_##name##_handler,
+#define B_TYPE(prefix, name, ...) &&prefix##_##name##_handler,
+#define U_TYPE(prefix, name, ...) &&prefix##_##name##_handler,
+#define J_TYPE(prefix, name, ...) &&prefix##_##name##_handler,
+#define CUSTOM(prefix, name, ...) &&prefix##_##name##_handler,
+#include "defs/instructions.inc"
+        &&BLOCK_END_handler,
+    };
+    static_assert(sizeof(handlers) / sizeof(*handlers) == BLOCK_END + 1);
+
+    hart::BareHartState hs(state);
+    auto& mem = state.mem();
+    const auto code_generation = mem.getCodeGeneration();
+    const DecodedInstruction* ip = block;
+
+#define DISPATCH goto* handlers[ip->opcode]
+    DISPATCH;
+
+// a store that hits translated code may have changed the rest of this block,
+// so stop and let the caller translate it again
+#define AFTER_R_TYPE
+#define AFTER_I_TYPE
+#define AFTER_S_TYPE                                                           \
+    if(mem.getCodeGeneration() != code_generation) return ip - block + 1;
+#define AFTER_B_TYPE
+#define AFTER_U_TYPE
+#define AFTER_J_TYPE
+#define DECODED_EXECUTION(format, prefix, name, execution)                     \
+    prefix##_##name##_handler : {                                              \
+        const DecodedInstruction& decoded = *ip;                               \
+        [[maybe_unused]] uint32_t bits = decoded.bits;                         \
+        [[maybe_unused]] Opcode opcode = decoded.opcode;                       \
+        do {                                                                   \
+            execution;                                                         \
+        } while(0);                                                            \
+        AFTER_##format##_TYPE                                                  \
+    }                                                                          \
+    ip++;                                                                      \
+    DISPATCH;
+#include "decoded-instructions.inc"
+#undef DECODED_EXECUTION
+#undef AFTER_R_TYPE
+#undef AFTER_I_TYPE
+#undef AFTER_S_TYPE
+#undef AFTER_B_TYPE
+#undef AFTER_U_TYPE
+#undef AFTER_J_TYPE
+
+    // custom instructions have no fixed format, they run their execution
+    // function
+#define CUSTOM(prefix, name, ...)                                              \
+    prefix##_##name##_handler : prefix##_##name##_execution_func(*ip, hs);     \
+    ip++;                                                                      \
+    DISPATCH;
+#include "defs/instructions.inc"
+
+UNKNOWN_handler:
+    ip->execute(*ip, state);
+    ip++;
+    DISPATCH;
+#undef DISPATCH
+
+BLOCK_END_handler:
+    return ip - block;
 }
 
 #define CUSTOM(prefix, name, opcode, matcher, printer, execution, precedence)  \
@@ -78,9 +78,8 @@ constexpr Word setBitRange(Word bits, Word toSet) {
 }
 
 template <std::size_t B> constexpr __int128_t signext128(uint64_t value) {
-    static_assert(B <= 128 && B >= 0, "Invalid Size");
-    return __int128_t(value);
-    // return __int128_t(value << (128 - B)) >> (128 - B);
+    static_assert(B <= 64 && B >= 0, "Invalid Size");
+    return __int128_t(int64_t(value << (64 - B)) >> (64 - B));
 }
 template <std::size_t B> constexpr int64_t signext64(uint64_t value) {
     static_assert(B <= 64 && B >= 0, "Invalid Size");
@@ -6,14 +6,17 @@
 #include "event/event.h"
 #include "hart/types.h"
 
+#include <algorithm>
 #include <array>
 #include <bitset>
 #include <cassert>
 #include <cstdint>
+#include <deque>
 #include <iomanip>
 #include <ostream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 constexpr static types::UnsignedInteger getMask(types::UnsignedInteger N) {
     assert(N <= sizeof(types::UnsignedInteger) * 8);
@@ -69,8 +72,32 @@ class Register {
 };
 
 class RegisterClass {
+  public:
+    // register events carry a small id instead of the class name, so firing
+    // them does not copy a string. the name is looked up with getClassName
+    using ClassID = uint64_t;
+
+  private:
+    static std::deque<std::string>& classNames() {
+        static std::deque<std::string> names;
+        return names;
+    }
+
+  public:
+    static ClassID internClassName(const std::string& name) {
+        auto& names = classNames();
+        auto it = std::find(names.begin(), names.end(), name);
+        if(it != names.end()) return ClassID(it - names.begin());
+        names.push_back(name);
+        return ClassID(names.size() - 1);
+    }
+    static const std::string& getClassName(ClassID id) {
+        return classNames().at(id);
+    }
+
   private:
     std::string classname;
+    ClassID class_id;
     std::string regprefix;
     size_t num_registers;
     std::unique_ptr<Register[]> registers;
@@ -90,25 +117,72 @@ class RegisterClass {
             : rc(rc), reg_idx(reg_idx) {}
         operator T() {
             T v = read();
-            rc->event_read(rc->classname, reg_idx, v);
+            if(!rc->event_read.empty())
+                rc->event_read(rc->class_id, reg_idx, v);
+            if(rc->masked_reads.wants(reg_idx))
+                rc->masked_reads(rc->class_id, reg_idx, v);
             return v;
         }
         RegisterProxy& operator=(T v) {
+            bool masked = rc->masked_writes.wants(reg_idx);
+            if(rc->event_write.empty() && !masked) {
+                write(v);
+                return *this;
+            }
             T old_value = read();
             write(v);
-            rc->event_write(rc->classname, reg_idx, v, old_value);
+            if(!rc->event_write.empty())
+                rc->event_write(rc->class_id, reg_idx, v, old_value);
+            if(masked) rc->masked_writes(rc->class_id, reg_idx, v, old_value);
             return *this;
         }
     };
 
     // Subsystem: reg_$CLASS
     // Description: Fires when a register is read
-    // Parameters: (register class, register index, value read)
-    event::Event<std::string, uint64_t, uint64_t> event_read;
+    // Parameters: (register class id, register index, value read)
+    event::Event<ClassID, uint64_t, uint64_t> event_read;
     // Subsystem: reg_$CLASS
     // Description: Fires when a register is written
-    // Parameters: (register class, register index, value written, old value)
-    event::Event<std::string, uint64_t, uint64_t, uint64_t> event_write;
+    // Parameters: (register class id, register index, value written, old
+    // value)
+    event::Event<ClassID, uint64_t, uint64_t, uint64_t> event_write;
+
+  public:
+    // one bit per register, bit i for register i
+    using Mask = uint64_t;
+
+  private:
+    // listeners that only want some registers, the union of their masks
+    // rules most accesses out with one test
+    template <typename... Types> struct MaskedListener {
+        Mask mask;
+        typename event::Event<ClassID, uint64_t, Types...>::callback_type
+            callback;
+    };
+    template <typename... Types>
+    class MaskedEvent : public event::ListenerList<MaskedListener<Types...>> {
+      private:
+        Mask any = 0;
+
+        void changed() override {
+            any = 0;
+            this->forEach(
+                [this](const MaskedListener<Types...>& l) { any |= l.mask; });
+        }
+
+      public:
+        bool wants(uint64_t idx) const {
+            return idx < 64 && (any >> idx) & 1;
+        }
+        void operator()(ClassID rc, uint64_t idx, Types... args) {
+            this->forEach([&](const MaskedListener<Types...>& l) {
+                if((l.mask >> idx) & 1) l.callback(rc, idx, args...);
+            });
+        }
+    };
+    MaskedEvent<uint64_t> masked_reads;
+    MaskedEvent<uint64_t, uint64_t> masked_writes;
 
   public:
     template <typename... RegisterArgs>
@@ -117,8 +191,8 @@ class RegisterClass {
         std::string regprefix,
         size_t num_registers,
         RegisterArgs&&... init_registers)
-        : classname(classname), regprefix(regprefix),
-          num_registers(num_registers),
+        : classname(classname), class_id(internClassName(classname)),
+          regprefix(regprefix), num_registers(num_registers),
           registers(std::make_unique<Register[]>(num_registers)) {
         // start at index 0 and init all registers
         initRegisters(0, std::forward<RegisterArgs>(init_registers)...);
@@ -142,7 +216,8 @@ class RegisterClass {
   public:
     // cannot copy, only move
     RegisterClass()
-        : classname(), regprefix(), num_registers(0), registers(nullptr) {}
+        : classname(), class_id(internClassName("")), regprefix(),
+          num_registers(0), registers(nullptr) {}
     RegisterClass(const RegisterClass&) = delete;
     RegisterClass(RegisterClass&&) = default;
     RegisterClass& operator=(const RegisterClass&) = delete;
@@ -154,6 +229,14 @@ class RegisterClass {
         return registers[idx];
     }
 
+    // direct access to the registers, reads and writes through it do not
+    // fire events
+    struct BareView {
+        Register* registers = nullptr;
+        Register& operator[](unsigned idx) { return registers[idx]; }
+    };
+    BareView bare() { return BareView{registers.get()}; }
+
     RegisterProxy reg(unsigned idx) {
         assert(registers && idx < num_registers);
         return RegisterProxy(this, idx);
@@ -161,6 +244,7 @@ class RegisterClass {
     RegisterProxy operator[](unsigned idx) { return reg(idx); }
 
     const std::string& getName() { return classname; }
+    ClassID getClassID() const { return class_id; }
     void dump(std::ostream& o) {
         o << getName();
         auto quart = num_registers / 4;
@@ -176,14 +260,30 @@ class RegisterClass {
         }
     }
 
-    void addReadListener(
-        event::Event<std::string, uint64_t, uint64_t>::callback_type func) {
-        event_read.addListener(func);
+    event::ListenerHandle addReadListener(
+        event::Event<ClassID, uint64_t, uint64_t>::callback_type func) {
+        return event_read.addListener(std::move(func));
     }
-    void addWriteListener(
-        event::Event<std::string, uint64_t, uint64_t, uint64_t>::callback_type
+    event::ListenerHandle addWriteListener(
+        event::Event<ClassID, uint64_t, uint64_t, uint64_t>::callback_type
             func) {
-        event_write.addListener(func);
+        return event_write.addListener(std::move(func));
+    }
+    // listeners for the registers in mask only
+    event::ListenerHandle addReadListener(
+        Mask mask,
+        event::Event<ClassID, uint64_t, uint64_t>::callback_type func) {
+        return masked_reads.add({mask, std::move(func)});
+    }
+    event::ListenerHandle addWriteListener(
+        Mask mask,
+        event::Event<ClassID, uint64_t, uint64_t, uint64_t>::callback_type
+            func) {
+        return masked_writes.add({mask, std::move(func)});
+    }
+    bool hasListeners() const {
+        return !event_read.empty() || !event_write.empty() ||
+               !masked_reads.empty() || !masked_writes.empty();
     }
 };
 
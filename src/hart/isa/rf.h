@@ -8,6 +8,7 @@
 
 #include <array>
 #include <optional>
+#include <vector>
 
 namespace isa {
 namespace rf {
@@ -66,24 +67,56 @@ class RegisterFile {
         #reg_prefix,                                                           \
         number_regs,                                                           \
         REGISTER_CLASS_##classname(REG_CASE)};                                 \
-    template <typename T> void add##classname##ReadListener(T&& arg) {         \
-        classname.addReadListener(std::forward<T>(arg));                       \
+    template <typename T>                                                      \
+    event::ListenerHandle add##classname##ReadListener(T&& arg) {              \
+        return classname.addReadListener(std::forward<T>(arg));                \
     }                                                                          \
-    template <typename T> void add##classname##WriteListener(T&& arg) {        \
-        classname.addWriteListener(std::forward<T>(arg));                      \
+    template <typename T>                                                      \
+    event::ListenerHandle add##classname##WriteListener(T&& arg) {             \
+        return classname.addWriteListener(std::forward<T>(arg));               \
     }
 #include "defs/registers.inc"
 #undef REG_CASE
 
-    template <typename T> void addReadListener(T&& arg) {
+    // listeners for every class, with a handle for each class
+    template <typename T>
+    std::vector<event::ListenerHandle> addReadListener(T&& arg) {
+        std::vector<event::ListenerHandle> handles;
 #define REGISTER_CLASS(classname, reg_prefix, number_regs, reg_size)           \
-    add##classname##ReadListener(std::forward<T>(arg));
+    handles.push_back(add##classname##ReadListener(arg));
 #include "defs/registers.inc"
+        return handles;
     }
-    template <typename T> void addWriteListener(T&& arg) {
+    template <typename T>
+    std::vector<event::ListenerHandle> addWriteListener(T&& arg) {
+        std::vector<event::ListenerHandle> handles;
 #define REGISTER_CLASS(classname, reg_prefix, number_regs, reg_size)           \
-    add##classname##WriteListener(std::forward<T>(arg));
+    handles.push_back(add##classname##WriteListener(arg));
 #include "defs/registers.inc"
+        return handles;
+    }
+
+    // listeners for the registers of one class that are set in mask
+    template <typename T>
+    event::ListenerHandle
+    addReadListener(RegisterClassType rct, RegisterClass::Mask mask, T&& arg) {
+        return getRegisterClassForType(rct)->addReadListener(
+            mask,
+            std::forward<T>(arg));
+    }
+    template <typename T>
+    event::ListenerHandle
+    addWriteListener(RegisterClassType rct, RegisterClass::Mask mask, T&& arg) {
+        return getRegisterClassForType(rct)->addWriteListener(
+            mask,
+            std::forward<T>(arg));
+    }
+
+    bool hasListeners() const {
+#define REGISTER_CLASS(classname, reg_prefix, number_regs, reg_size)           \
+    if(classname.hasListeners()) return true;
+#include "defs/registers.inc"
+        return false;
     }
 
     RegisterClass* getRegisterClassForType(RegisterClassType rct) {
@@ -95,6 +128,21 @@ class RegisterFile {
     }
 };
 
+// the registers of a RegisterFile without events, for instruction bodies to
+// use when nothing is listening
+class BareRegisterFile {
+  public:
+#define REGISTER_CLASS(classname, reg_prefix, number_regs, reg_size)           \
+    RegisterClass::BareView classname;
+#include "defs/registers.inc"
+
+    BareRegisterFile(RegisterFile& rf) {
+#define REGISTER_CLASS(classname, reg_prefix, number_regs, reg_size)           \
+    classname = rf.classname.bare();
+#include "defs/registers.inc"
+    }
+};
+
 [[maybe_unused]] static auto getAllPossibleRegisterNames() {
 #define REG_CASE(classname, index, nice_name, ...)                             \
     std::string(#nice_name),                                                   \
@@ -0,0 +1,728 @@
+#include "jit.h"
+
+#include "hart/hart.h"
+#include "hart/hartstate.h"
+#include "hart/isa/inst.h"
+#include "hart/isa/rf.h"
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <type_traits>
+
+#if defined(__x86_64__)
+    #include <sys/mman.h>
+    #include <unistd.h>
+
+    #include "x86-64.h"
+#endif
+
+#include "hart/block-cache.h"
+
+namespace hart {
+namespace jit {
+
+static constexpr unsigned NUM_GPRS = sizeof(Context::gpr) / sizeof(uint64_t);
+static_assert(std::is_standard_layout_v<Context>);
+
+template <typename T>
+static auto cell(mem::MemoryImage& mem, types::Address addr) {
+    if constexpr(sizeof(T) == 1) return mem.byte(addr);
+    else if constexpr(sizeof(T) == 2) return mem.halfword(addr);
+    else if constexpr(sizeof(T) == 4) return mem.word(addr);
+    else return mem.doubleword(addr);
+}
+
+#if defined(__x86_64__)
+
+namespace {
+
+using x86_64::Access;
+using x86_64::Alu;
+using x86_64::Assembler;
+using x86_64::Cond;
+using x86_64::Reg;
+using x86_64::Shift;
+using isa::inst::Opcode;
+
+constexpr int32_t gpr(unsigned i) {
+    return int32_t(offsetof(Context, gpr) + i * sizeof(uint64_t));
+}
+constexpr int32_t PC = offsetof(Context, pc);
+constexpr int32_t EXIT = offsetof(Context, exit);
+constexpr int32_t LOAD = offsetof(Context, load);
+constexpr int32_t STORE = offsetof(Context, store);
+constexpr int32_t BASE = offsetof(mem::MemoryImage::HostRange, base);
+constexpr int32_t SIZE = offsetof(mem::MemoryImage::HostRange, size);
+constexpr int32_t HOST = offsetof(mem::MemoryImage::HostRange, host);
+
+// the slow paths native code calls out to
+struct Helpers {
+    const void* load[7];
+    const void* store[4];
+    const void* interpret;
+    // stores may go straight to the host buffer
+    bool fast_stores;
+};
+
+// native blocks are called with the context in rdi, which is kept in rbx
+void emitEntry(Assembler& as) {
+    as.push(Reg::RBX);
+    as.mov(Reg::RBX, Reg::RDI);
+}
+void emitReturn(Assembler& as) {
+    as.pop(Reg::RBX);
+    as.ret();
+}
+void emitExit(Assembler& as, types::Address pc) {
+    as.movImm(Reg::RAX, pc);
+    as.store(PC, Reg::RAX);
+    emitReturn(as);
+}
+// leave the block if a slow path did not exit normally, it has already set pc
+void emitCheckExit(Assembler& as) {
+    as.cmpByte(EXIT, uint8_t(Exit::NORMAL));
+    auto ok = as.jcc(Cond::E);
+    emitReturn(as);
+    as.bind(ok);
+}
+
+// rax and rsi = rs1 + imm
+void emitAddress(Assembler& as, const isa::inst::DecodedInstruction& inst) {
+    as.load(Reg::RAX, gpr(inst.rs1));
+    if(inst.imm != 0) as.aluImm(Alu::ADD, Reg::RAX, int32_t(inst.imm));
+    as.mov(Reg::RSI, Reg::RAX);
+}
+// turns the guest address in rax into a host address using the cached region
+// at offset cache, jumping to the returned labels if the access does not fit
+std::pair<Assembler::Label, Assembler::Label>
+emitCacheCheck(Assembler& as, int32_t cache, unsigned width) {
+    as.alu(Alu::SUB, Reg::RAX, cache + BASE);
+    as.alu(Alu::CMP, Reg::RAX, cache + SIZE);
+    auto below = as.jcc(Cond::AE);
+    as.mov(Reg::RCX, Reg::RAX);
+    as.aluImm(Alu::ADD, Reg::RCX, int32_t(width));
+    as.alu(Alu::CMP, Reg::RCX, cache + SIZE);
+    auto above = as.jcc(Cond::A);
+    as.alu(Alu::ADD, Reg::RAX, cache + HOST);
+    return {below, above};
+}
+
+void emitLoad(
+    Assembler& as,
+    const isa::inst::DecodedInstruction& inst,
+    types::Address pc,
+    Access access,
+    unsigned width,
+    const Helpers& helpers) {
+    emitAddress(as, inst);
+    auto [below, above] = emitCacheCheck(as, LOAD, width);
+    as.loadRAX(access);
+    auto done = as.jmp();
+    as.bind(below);
+    as.bind(above);
+    as.mov(Reg::RDI, Reg::RBX);
+    as.movImm(Reg::RDX, pc);
+    as.call(helpers.load[size_t(access)]);
+    emitCheckExit(as);
+    as.bind(done);
+    if(inst.rd != 0) as.store(gpr(inst.rd), Reg::RAX);
+}
+
+void emitStore(
+    Assembler& as,
+    const isa::inst::DecodedInstruction& inst,
+    types::Address pc,
+    Access access,
+    unsigned width,
+    const Helpers& helpers) {
+    emitAddress(as, inst);
+    as.load(Reg::RDX, gpr(inst.rs2));
+    Assembler::Label done = 0;
+    if(helpers.fast_stores) {
+        auto [below, above] = emitCacheCheck(as, STORE, width);
+        as.storeRAX(access, Reg::RDX);
+        done = as.jmp();
+        as.bind(below);
+        as.bind(above);
+    }
+    as.mov(Reg::RDI, Reg::RBX);
+    as.movImm(Reg::RCX, pc);
+    as.call(helpers.store[size_t(access)]);
+    emitCheckExit(as);
+    if(helpers.fast_stores) as.bind(done);
+}
+
+void emitRegisterOp(
+    Assembler& as,
+    const isa::inst::DecodedInstruction& inst,
+    Alu op,
+    bool wide = true) {
+    if(inst.rd == 0) return;
+    as.load(Reg::RAX, gpr(inst.rs1), wide);
+    as.alu(op, Reg::RAX, gpr(inst.rs2), wide);
+    if(!wide) as.movsxd(Reg::RAX, Reg::RAX);
+    as.store(gpr(inst.rd), Reg::RAX);
+}
+void emitImmediateOp(
+    Assembler& as,
+    const isa::inst::DecodedInstruction& inst,
+    Alu op,
+    bool wide = true) {
+    if(inst.rd == 0) return;
+    as.load(Reg::RAX, gpr(inst.rs1), wide);
+    as.aluImm(op, Reg::RAX, int32_t(inst.imm), wide);
+    if(!wide) as.movsxd(Reg::RAX, Reg::RAX);
+    as.store(gpr(inst.rd), Reg::RAX);
+}
+void emitSet(
+    Assembler& as,
+    const isa::inst::DecodedInstruction& inst,
+    Cond cond,
+    bool immediate) {
+    if(inst.rd == 0) return;
+    as.load(Reg::RAX, gpr(inst.rs1));
+    if(immediate) as.aluImm(Alu::CMP, Reg::RAX, int32_t(inst.imm));
+    else as.alu(Alu::CMP, Reg::RAX, gpr(inst.rs2));
+    as.setcc(cond, Reg::RAX);
+    as.store(gpr(inst.rd), Reg::RAX);
+}
+void emitConstant(
+    Assembler& as,
+    const isa::inst::DecodedInstruction& inst,
+    uint64_t value) {
+    if(inst.rd == 0) return;
+    as.movImm(Reg::RAX, value);
+    as.store(gpr(inst.rd), Reg::RAX);
+}
+// the rv64 immediate shifts are custom instructions, the shift amount is
+// read from the raw bits
+void emitShiftImmediate(
+    Assembler& as,
+    const isa::inst::DecodedInstruction& inst,
+    Shift op,
+    bool wide = true) {
+    if(inst.rd == 0) return;
+    auto shamt = uint8_t((inst.bits >> 20) & (wide ? 0x3F : 0x1F));
+    as.load(Reg::RAX, gpr(inst.rs1), wide);
+    as.shiftImm(op, Reg::RAX, shamt, wide);
+    if(!wide) as.movsxd(Reg::RAX, Reg::RAX);
+    as.store(gpr(inst.rd), Reg::RAX);
+}
+// x86 masks the shift count to 6 bits, or 5 for 32 bit shifts, the same as
+// the rv64 shifts and their w forms
+void emitShiftRegister(
+    Assembler& as,
+    const isa::inst::DecodedInstruction& inst,
+    Shift op,
+    bool wide = true) {
+    if(inst.rd == 0) return;
+    as.load(Reg::RAX, gpr(inst.rs1), wide);
+    as.load(Reg::RCX, gpr(inst.rs2));
+    as.shiftCL(op, Reg::RAX, wide);
+    if(!wide) as.movsxd(Reg::RAX, Reg::RAX);
+    as.store(gpr(inst.rd), Reg::RAX);
+}
+void emitMultiply(
+    Assembler& as,
+    const isa::inst::DecodedInstruction& inst,
+    bool wide) {
+    if(inst.rd == 0) return;
+    as.load(Reg::RAX, gpr(inst.rs1), wide);
+    as.imul(Reg::RAX, gpr(inst.rs2), wide);
+    if(!wide) as.movsxd(Reg::RAX, Reg::RAX);
+    as.store(gpr(inst.rd), Reg::RAX);
+}
+void emitBranch(
+    Assembler& as,
+    const isa::inst::DecodedInstruction& inst,
+    types::Address pc,
+    Cond cond) {
+    as.load(Reg::RAX, gpr(inst.rs1));
+    as.alu(Alu::CMP, Reg::RAX, gpr(inst.rs2));
+    auto taken = as.jcc(cond);
+    emitExit(as, pc + inst.opcode.getInstructionSize());
+    as.bind(taken);
+    emitExit(as, pc + inst.imm);
+}
+// instructions with awkward semantics run their interpreter body, with the
+// source registers copied out to the register file and rd copied back
+void emitInterpret(
+    Assembler& as,
+    const isa::inst::DecodedInstruction& inst,
+    const Helpers& helpers) {
+    as.mov(Reg::RDI, Reg::RBX);
+    as.movImm(Reg::RSI, uint64_t(&inst));
+    as.call(helpers.interpret);
+}
+
+// returns false if the instruction cannot be compiled
+bool emitInstruction(
+    Assembler& as,
+    const isa::inst::DecodedInstruction& inst,
+    types::Address pc,
+    const Helpers& helpers) {
+    switch(Opcode::ValueType(inst.opcode)) {
+        case Opcode::rv32i_lui: emitConstant(as, inst, inst.imm); break;
+        case Opcode::rv32i_auipc: emitConstant(as, inst, inst.imm + pc); break;
+
+        case Opcode::rv32i_addi: emitImmediateOp(as, inst, Alu::ADD); break;
+        case Opcode::rv32i_xori: emitImmediateOp(as, inst, Alu::XOR); break;
+        case Opcode::rv32i_ori: emitImmediateOp(as, inst, Alu::OR); break;
+        case Opcode::rv32i_andi: emitImmediateOp(as, inst, Alu::AND); break;
+        case Opcode::rv32i_slti: emitSet(as, inst, Cond::L, true); break;
+        case Opcode::rv32i_sltiu: emitSet(as, inst, Cond::B, true); break;
+        case Opcode::rv64i_addiw:
+            emitImmediateOp(as, inst, Alu::ADD, false);
+            break;
+
+        case Opcode::rv32i_add: emitRegisterOp(as, inst, Alu::ADD); break;
+        case Opcode::rv32i_sub: emitRegisterOp(as, inst, Alu::SUB); break;
+        case Opcode::rv32i_xor: emitRegisterOp(as, inst, Alu::XOR); break;
+        case Opcode::rv32i_or: emitRegisterOp(as, inst, Alu::OR); break;
+        case Opcode::rv32i_and: emitRegisterOp(as, inst, Alu::AND); break;
+        case Opcode::rv32i_slt: emitSet(as, inst, Cond::L, false); break;
+        case Opcode::rv32i_sltu: emitSet(as, inst, Cond::B, false); break;
+        case Opcode::rv64i_addw:
+            emitRegisterOp(as, inst, Alu::ADD, false);
+            break;
+        case Opcode::rv64i_subw:
+            emitRegisterOp(as, inst, Alu::SUB, false);
+            break;
+
+        case Opcode::rv64i_slli:
+            emitShiftImmediate(as, inst, Shift::SHL);
+            break;
+        case Opcode::rv64i_srli:
+            emitShiftImmediate(as, inst, Shift::SHR);
+            break;
+        case Opcode::rv64i_srai:
+            emitShiftImmediate(as, inst, Shift::SAR);
+            break;
+        case Opcode::rv64i_sll: emitShiftRegister(as, inst, Shift::SHL); break;
+        case Opcode::rv64i_srl: emitShiftRegister(as, inst, Shift::SHR); break;
+        case Opcode::rv64i_sra: emitShiftRegister(as, inst, Shift::SAR); break;
+        case Opcode::rv64i_slliw:
+            emitShiftImmediate(as, inst, Shift::SHL, false);
+            break;
+        case Opcode::rv64i_srliw:
+            emitShiftImmediate(as, inst, Shift::SHR, false);
+            break;
+        case Opcode::rv64i_sraiw:
+            emitShiftImmediate(as, inst, Shift::SAR, false);
+            break;
+        case Opcode::rv64i_sllw:
+            emitShiftRegister(as, inst, Shift::SHL, false);
+            break;
+        case Opcode::rv64i_srlw:
+            emitShiftRegister(as, inst, Shift::SHR, false);
+            break;
+        case Opcode::rv64i_sraw:
+            emitShiftRegister(as, inst, Shift::SAR, false);
+            break;
+
+        case Opcode::rv32m_mul: emitMultiply(as, inst, true); break;
+        case Opcode::rv64m_mulw: emitMultiply(as, inst, false); break;
+
+        case Opcode::rv32m_mulh:
+        case Opcode::rv32m_mulhsu:
+        case Opcode::rv32m_mulhu:
+        case Opcode::rv32m_div:
+        case Opcode::rv32m_divu:
+        case Opcode::rv32m_rem:
+        case Opcode::rv32m_remu:
+        case Opcode::rv64m_divw:
+        case Opcode::rv64m_divuw:
+        case Opcode::rv64m_remw:
+        case Opcode::rv64m_remuw: emitInterpret(as, inst, helpers); break;
+
+        case Opcode::rv32i_lb:
+            emitLoad(as, inst, pc, Access::BYTE_SIGNED, 1, helpers);
+            break;
+        case Opcode::rv32i_lh:
+            emitLoad(as, inst, pc, Access::HALFWORD_SIGNED, 2, helpers);
+            break;
+        case Opcode::rv32i_lw:
+            emitLoad(as, inst, pc, Access::WORD_SIGNED, 4, helpers);
+            break;
+        case Opcode::rv32i_lbu:
+            emitLoad(as, inst, pc, Access::BYTE, 1, helpers);
+            break;
+        case Opcode::rv32i_lhu:
+            emitLoad(as, inst, pc, Access::HALFWORD, 2, helpers);
+            break;
+        case Opcode::rv64i_lwu:
+            emitLoad(as, inst, pc, Access::WORD, 4, helpers);
+            break;
+        case Opcode::rv64i_ld:
+            emitLoad(as, inst, pc, Access::DOUBLEWORD, 8, helpers);
+            break;
+
+        case Opcode::rv32i_sb:
+            emitStore(as, inst, pc, Access::BYTE, 1, helpers);
+            break;
+        case Opcode::rv32i_sh:
+            emitStore(as, inst, pc, Access::HALFWORD, 2, helpers);
+            break;
+        case Opcode::rv32i_sw:
+            emitStore(as, inst, pc, Access::WORD, 4, helpers);
+            break;
+        case Opcode::rv64i_sd:
+            emitStore(as, inst, pc, Access::DOUBLEWORD, 8, helpers);
+            break;
+
+        case Opcode::rv32i_beq: emitBranch(as, inst, pc, Cond::E); break;
+        case Opcode::rv32i_bne: emitBranch(as, inst, pc, Cond::NE); break;
+        case Opcode::rv32i_blt: emitBranch(as, inst, pc, Cond::L); break;
+        case Opcode::rv32i_bge: emitBranch(as, inst, pc, Cond::GE); break;
+        case Opcode::rv32i_bltu: emitBranch(as, inst, pc, Cond::B); break;
+        case Opcode::rv32i_bgeu: emitBranch(as, inst, pc, Cond::AE); break;
+
+        case Opcode::rv32i_jal:
+            // a jump to itself halts the hart, left to the interpreter
+            if(inst.imm == 0) return false;
+            emitConstant(as, inst, pc + inst.opcode.getInstructionSize());
+            emitExit(as, pc + inst.imm);
+            break;
+        case Opcode::rv32i_jalr:
+            // the target is computed before rd is written, rd may be rs1
+            as.load(Reg::RAX, gpr(inst.rs1));
+            as.aluImm(Alu::ADD, Reg::RAX, int32_t(inst.imm));
+            as.aluImm(Alu::AND, Reg::RAX, ~1);
+            as.store(PC, Reg::RAX);
+            emitConstant(as, inst, pc + inst.opcode.getInstructionSize());
+            emitReturn(as);
+            break;
+
+        case Opcode::rv32i_fence: break;
+
+        default: return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool Jit::isSupported() { return true; }
+
+#else
+
+bool Jit::isSupported() { return false; }
+
+#endif
+
+Jit::Jit(bool verify)
+    : ctx(), verify(verify), registers_loaded(false), code_buffer(nullptr),
+      code_used(0), epoch(1), exception(), stores() {
+    ctx.jit = this;
+#if defined(__x86_64__)
+    // the buffer is never writable and executable at once, hosts that
+    // enforce W^X refuse such mappings. compile makes the pages it copies
+    // code into writable for just as long as that takes
+    void* buffer = mmap(
+        nullptr,
+        CODE_BUFFER_SIZE,
+        PROT_READ | PROT_EXEC,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0);
+    if(buffer != MAP_FAILED) code_buffer = (uint8_t*)buffer;
+    else std::cerr << "Could not allocate memory for the JIT" << std::endl;
+#endif
+}
+
+Jit::~Jit() {
+#if defined(__x86_64__)
+    if(code_buffer) munmap(code_buffer, CODE_BUFFER_SIZE);
+#endif
+}
+
+Jit::NativeBlock Jit::compile([[maybe_unused]] const TranslatedBlock& block) {
+#if defined(__x86_64__)
+    if(code_buffer == nullptr) return nullptr;
+
+    Helpers helpers = {
+        {
+            reinterpret_cast<const void*>(&loadSlow<uint8_t, false>),
+            reinterpret_cast<const void*>(&loadSlow<uint16_t, false>),
+            reinterpret_cast<const void*>(&loadSlow<uint32_t, false>),
+            reinterpret_cast<const void*>(&loadSlow<uint64_t, false>),
+            reinterpret_cast<const void*>(&loadSlow<uint8_t, true>),
+            reinterpret_cast<const void*>(&loadSlow<uint16_t, true>),
+            reinterpret_cast<const void*>(&loadSlow<uint32_t, true>),
+        },
+        {
+            reinterpret_cast<const void*>(&storeSlow<uint8_t>),
+            reinterpret_cast<const void*>(&storeSlow<uint16_t>),
+            reinterpret_cast<const void*>(&storeSlow<uint32_t>),
+            reinterpret_cast<const void*>(&storeSlow<uint64_t>),
+        },
+        reinterpret_cast<const void*>(&interpret),
+        // verification has to see every store to undo it
+        !verify,
+    };
+
+    Assembler as;
+    emitEntry(as);
+    types::Address pc = block.start;
+    // the last instruction is blockEnd()
+    for(size_t i = 0; i + 1 < block.insts.size(); i++) {
+        const auto& inst = block.insts[i];
+        if(!emitInstruction(as, inst, pc, helpers)) return nullptr;
+        pc += inst.opcode.getInstructionSize();
+    }
+    // a block cut short falls through to the next one
+    auto last = block.insts[block.insts.size() - 2].opcode;
+    if(!last.isBType() && !last.isJType() &&
+       last != isa::inst::Opcode::rv32i_jalr)
+        emitExit(as, block.end);
+
+    const auto& code = as.getCode();
+    if(code.size() > CODE_BUFFER_SIZE) return nullptr;
+    if(code_used + code.size() > CODE_BUFFER_SIZE) {
+        code_used = 0;
+        epoch++;
+    }
+    auto native = code_buffer + code_used;
+    auto page_size = uintptr_t(sysconf(_SC_PAGESIZE));
+    auto lower = uintptr_t(native) & ~(page_size - 1);
+    auto upper = (uintptr_t(native) + code.size() + page_size - 1) &
+                 ~(page_size - 1);
+    if(mprotect((void*)lower, upper - lower, PROT_READ | PROT_WRITE) != 0)
+        return nullptr;
+    std::memcpy(native, code.data(), code.size());
+    if(mprotect((void*)lower, upper - lower, PROT_READ | PROT_EXEC) != 0) {
+        // blocks sharing these pages can no longer run, so nothing native
+        // runs again
+        std::cerr << "Could not protect the JIT code buffer" << std::endl;
+        munmap(code_buffer, CODE_BUFFER_SIZE);
+        code_buffer = nullptr;
+        epoch++;
+        return nullptr;
+    }
+    // keep each block aligned
+    code_used = (code_used + code.size() + 15) & ~size_t(15);
+    return reinterpret_cast<NativeBlock>(native);
+#else
+    return nullptr;
+#endif
+}
+
+template <typename T, bool SIGNED>
+uint64_t Jit::loadSlow(Context* ctx, types::Address addr, uint64_t pc) {
+    auto& mem = ctx->hs->mem();
+    try {
+        if(mem.isWatched(mem::MemoryImage::Access::LOAD, addr, sizeof(T)))
+            publish(ctx, pc);
+        T value = cell<T>(mem, addr);
+        if(auto range = mem.getLoadRange(addr)) ctx->load = *range;
+        if constexpr(SIGNED) return uint64_t(std::make_signed_t<T>(value));
+        else return value;
+    } catch(...) {
+        ctx->jit->exception = std::current_exception();
+        ctx->exit = Exit::EXCEPTION;
+        ctx->pc = pc;
+        return 0;
+    }
+}
+
+template <typename T>
+void Jit::storeSlow(
+    Context* ctx,
+    types::Address addr,
+    uint64_t value,
+    uint64_t pc) {
+    auto& mem = ctx->hs->mem();
+    auto code_generation = mem.getCodeGeneration();
+    try {
+        if(ctx->jit->verify) {
+            if(auto ptr = mem.raw(addr)) {
+                StoreRecord record{addr, 0, sizeof(T)};
+                std::memcpy(&record.old_value, ptr, sizeof(T));
+                ctx->jit->stores.push_back(record);
+            }
+        }
+        if(mem.isWatched(mem::MemoryImage::Access::STORE, addr, sizeof(T)))
+            publish(ctx, pc);
+        cell<T>(mem, addr) = T(value);
+    } catch(...) {
+        ctx->jit->exception = std::current_exception();
+        ctx->exit = Exit::EXCEPTION;
+        ctx->pc = pc;
+        return;
+    }
+    if(mem.getCodeGeneration() != code_generation) {
+        ctx->exit = Exit::CODE_WRITTEN;
+        ctx->pc = pc + sizeof(types::InstructionWord);
+    } else if(auto range = mem.getStoreRange(addr);
+              range && !mem.isCode(range->base, range->size)) {
+        // stores to code always take the slow path, so they are noticed
+        ctx->store = *range;
+    }
+}
+
+void Jit::publish(Context* ctx, uint64_t pc) {
+    auto& gpr = ctx->hs->rf().GPR;
+    for(unsigned i = 0; i < NUM_GPRS; i++) {
+        gpr.rawreg(i).set(ctx->gpr[i]);
+    }
+    ctx->hs->pc = pc;
+}
+
+void Jit::interpret(Context* ctx, const isa::inst::DecodedInstruction* inst) {
+    auto& gpr = ctx->hs->rf().GPR;
+    gpr.rawreg(inst->rs1).set(ctx->gpr[inst->rs1]);
+    gpr.rawreg(inst->rs2).set(ctx->gpr[inst->rs2]);
+    inst->execute(*inst, *ctx->hs);
+    ctx->gpr[inst->rd] = gpr.rawreg(inst->rd).get();
+}
+
+void Jit::loadRegisters(HartState& hs) {
+    if(registers_loaded) return;
+    auto& gpr = hs.rf().GPR;
+    for(unsigned i = 0; i < NUM_GPRS; i++) {
+        ctx.gpr[i] = gpr.rawreg(i).get();
+    }
+    ctx.hs = &hs;
+    registers_loaded = true;
+}
+
+void Jit::sync(HartState& hs) {
+    if(!registers_loaded) return;
+    auto& gpr = hs.rf().GPR;
+    for(unsigned i = 0; i < NUM_GPRS; i++) {
+        gpr.rawreg(i).set(ctx.gpr[i]);
+    }
+    registers_loaded = false;
+}
+
+void Jit::resetMemoryCaches() {
+    ctx.load = {};
+    ctx.store = {};
+}
+
+size_t Jit::execute(TranslatedBlock& block, HartState& hs) {
+    if(block.native == nullptr || block.native_epoch != epoch) {
+        if(block.native_unsupported) return 0;
+        if(++block.executions < HOT_THRESHOLD) return 0;
+        block.native = compile(block);
+        block.native_epoch = epoch;
+        if(block.native == nullptr) {
+            block.native_unsupported = true;
+            return 0;
+        }
+    }
+    if(verify) return executeVerified(block, hs);
+    else return executeNative(block, hs);
+}
+
+size_t Jit::executeNative(TranslatedBlock& block, HartState& hs) {
+    loadRegisters(hs);
+    ctx.exit = Exit::NORMAL;
+    block.native(&ctx);
+    hs.pc = ctx.pc;
+    if(ctx.exit == Exit::EXCEPTION) {
+        sync(hs);
+        auto e = exception;
+        exception = nullptr;
+        std::rethrow_exception(e);
+    }
+    if(ctx.exit == Exit::CODE_WRITTEN) return block.countBefore(ctx.pc);
+    return block.insts.size() - 1;
+}
+
+// runs the block natively, undoes everything it did, runs it again with the
+// interpreter, and compares the two
+size_t Jit::executeVerified(TranslatedBlock& block, HartState& hs) {
+    auto& gpr = hs.rf().GPR;
+    auto& mem = hs.mem();
+
+    stores.clear();
+    loadRegisters(hs);
+    uint64_t before[NUM_GPRS];
+    std::memcpy(before, ctx.gpr, sizeof(before));
+    ctx.exit = Exit::NORMAL;
+    block.native(&ctx);
+    // the store that hit translated code has already thrown that code away,
+    // which undoing the store cannot take back. the interpreter would then
+    // run past the store, so the native result is kept unchecked
+    if(ctx.exit == Exit::CODE_WRITTEN) {
+        hs.pc = ctx.pc;
+        return block.countBefore(ctx.pc);
+    }
+    registers_loaded = false;
+    auto native_exception = exception;
+    exception = nullptr;
+    auto native_pc = ctx.pc;
+
+    std::vector<uint64_t> native_values;
+    for(const auto& s : stores) {
+        uint64_t value = 0;
+        std::memcpy(&value, mem.raw(s.addr), s.size);
+        native_values.push_back(value);
+    }
+    for(auto it = stores.rbegin(); it != stores.rend(); it++) {
+        std::memcpy(mem.raw(it->addr), &it->old_value, it->size);
+    }
+    // interpreted instructions write to the register file and pc
+    for(unsigned i = 0; i < NUM_GPRS; i++) {
+        gpr.rawreg(i).set(before[i]);
+    }
+    hs.pc = block.start;
+
+    std::exception_ptr interpreter_exception;
+    size_t executed = 0;
+    try {
+        executed = isa::inst::executeBlock(block.insts.data(), hs);
+    } catch(...) {
+        interpreter_exception = std::current_exception();
+    }
+
+    std::stringstream diff;
+    diff << std::hex;
+    if(bool(native_exception) != bool(interpreter_exception)) {
+        diff << "  exception: native "
+             << (native_exception ? "threw" : "did not throw")
+             << ", interpreter "
+             << (interpreter_exception ? "threw" : "did not throw") << "\n";
+    }
+    if(native_pc != hs.pc) {
+        diff << "  pc: native 0x" << native_pc << ", interpreter 0x" << hs.pc
+             << "\n";
+    }
+    for(unsigned i = 0; i < NUM_GPRS; i++) {
+        if(ctx.gpr[i] != gpr.rawreg(i).get()) {
+            diff << "  x" << std::dec << i << std::hex << ": native 0x"
+                 << ctx.gpr[i] << ", interpreter 0x" << gpr.rawreg(i).get()
+                 << "\n";
+        }
+    }
+    for(size_t i = 0; i < stores.size(); i++) {
+        uint64_t value = 0;
+        std::memcpy(&value, mem.raw(stores[i].addr), stores[i].size);
+        if(value != native_values[i]) {
+            diff << "  memory 0x" << stores[i].addr << ": native 0x"
+                 << native_values[i] << ", interpreter 0x" << value << "\n";
+        }
+    }
+
+    if(!diff.str().empty()) {
+        std::cerr << "JIT mismatch in block at 0x" << std::hex << block.start
+                  << std::dec << "\n"
+                  << diff.str();
+        types::Address pc = block.start;
+        for(size_t i = 0; i + 1 < block.insts.size(); i++) {
+            std::cerr << "  " << std::hex << pc << std::dec << ": "
+                      << isa::inst::disassemble(block.insts[i].bits, pc)
+                      << "\n";
+            pc += block.insts[i].opcode.getInstructionSize();
+        }
+        throw HartException("JIT verification failed");
+    }
+    if(interpreter_exception) std::rethrow_exception(interpreter_exception);
+    return executed;
+}
+
+} // namespace jit
+} // namespace hart
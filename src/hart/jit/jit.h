@@ -0,0 +1,115 @@
+#ifndef ZIRCON_HART_JIT_JIT_H_
+#define ZIRCON_HART_JIT_JIT_H_
+
+#include "hart/isa/inst-execute.h"
+#include "hart/types.h"
+#include "mem/memory-image.h"
+
+#include <exception>
+#include <vector>
+
+namespace hart {
+class HartState;
+struct TranslatedBlock;
+
+namespace jit {
+
+class Jit;
+
+// how native code left its block
+enum class Exit : uint8_t {
+    // at the end of the block, pc is the next block
+    NORMAL = 0,
+    // a store hit translated code, pc is the instruction after the store
+    CODE_WRITTEN = 1,
+    // an instruction threw, pc is that instruction
+    EXCEPTION = 2,
+};
+
+// the state native code works on, addressed through a register so it must
+// stay standard layout
+struct Context {
+    uint64_t gpr[32];
+    types::Address pc;
+    Exit exit;
+    // the memory regions used by the last slow load and store, accesses that
+    // fall inside them go straight to the host buffer
+    mem::MemoryImage::HostRange load;
+    mem::MemoryImage::HostRange store;
+    HartState* hs;
+    Jit* jit;
+};
+
+// compiles hot translated blocks to x86-64, falling back to the interpreter
+// for anything it cannot compile
+class Jit {
+  public:
+    // a block is compiled after being run this many times
+    static constexpr uint32_t HOT_THRESHOLD = 16;
+    static constexpr size_t CODE_BUFFER_SIZE = 16 << 20;
+
+    // true if native code can be run on this host
+    static bool isSupported();
+
+  private:
+    using NativeBlock = void (*)(Context*);
+
+    Context ctx;
+    // run every block both ways and compare the results
+    bool verify;
+    // the guest registers live in ctx while this is set
+    bool registers_loaded;
+
+    uint8_t* code_buffer;
+    size_t code_used;
+    // bumped every time the code buffer is reused, native code from an older
+    // epoch is gone
+    uint32_t epoch;
+
+    std::exception_ptr exception;
+    // stores made by a verified block, so they can be undone
+    struct StoreRecord {
+        types::Address addr;
+        uint64_t old_value;
+        uint8_t size;
+    };
+    std::vector<StoreRecord> stores;
+
+    NativeBlock compile(const TranslatedBlock& block);
+    void loadRegisters(HartState& hs);
+    size_t executeNative(TranslatedBlock& block, HartState& hs);
+    size_t executeVerified(TranslatedBlock& block, HartState& hs);
+
+    template <typename T, bool SIGNED>
+    static uint64_t loadSlow(Context* ctx, types::Address addr, uint64_t pc);
+    template <typename T>
+    static void
+    storeSlow(Context* ctx, types::Address addr, uint64_t value, uint64_t pc);
+    static void
+    interpret(Context* ctx, const isa::inst::DecodedInstruction* inst);
+    // copy the registers and pc of the instruction at pc to the hart, so
+    // that watch listeners see them. changes the listeners make are lost
+    static void publish(Context* ctx, uint64_t pc);
+
+  public:
+    Jit(bool verify = false);
+    ~Jit();
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+
+    // run the block natively if it is hot and can be compiled. returns the
+    // number of instructions that ran, 0 if the caller has to interpret it
+    // instead
+    size_t execute(TranslatedBlock& block, HartState& hs);
+    // write the registers held by native code back to the register file, must
+    // be done before anything else looks at the hart
+    void sync(HartState& hs);
+    // forget the cached memory regions, translating code may have made them
+    // overlap code
+    void resetMemoryCaches();
+};
+
+} // namespace jit
+} // namespace hart
+
+#endif
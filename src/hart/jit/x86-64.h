@@ -0,0 +1,288 @@
+#ifndef ZIRCON_HART_JIT_X86_64_H_
+#define ZIRCON_HART_JIT_X86_64_H_
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace hart {
+namespace jit {
+namespace x86_64 {
+
+// only the registers that need no REX.B/REX.R prefix are used
+enum class Reg : uint8_t {
+    RAX = 0,
+    RCX = 1,
+    RDX = 2,
+    RBX = 3,
+    RSP = 4,
+    RBP = 5,
+    RSI = 6,
+    RDI = 7,
+};
+
+// the /digit of the 0x81 group, also used to form the register forms
+enum class Alu : uint8_t {
+    ADD = 0,
+    OR = 1,
+    AND = 4,
+    SUB = 5,
+    XOR = 6,
+    CMP = 7,
+};
+
+enum class Shift : uint8_t {
+    SHL = 4,
+    SHR = 5,
+    SAR = 7,
+};
+
+enum class Cond : uint8_t {
+    B = 0x2,
+    AE = 0x3,
+    E = 0x4,
+    NE = 0x5,
+    BE = 0x6,
+    A = 0x7,
+    L = 0xC,
+    GE = 0xD,
+    LE = 0xE,
+    G = 0xF,
+};
+
+// width and extension of a memory access through [rax]
+enum class Access : uint8_t {
+    BYTE,
+    HALFWORD,
+    WORD,
+    DOUBLEWORD,
+    BYTE_SIGNED,
+    HALFWORD_SIGNED,
+    WORD_SIGNED,
+};
+
+// a minimal x86-64 encoder. memory operands are either [rbx+disp32], with rbx
+// holding the base of a context structure, or [rax]
+class Assembler {
+  public:
+    using Label = size_t;
+
+  private:
+    std::vector<uint8_t> code;
+
+    static constexpr uint8_t REX_W = 0x48;
+    static uint8_t reg(Reg r) { return uint8_t(r); }
+
+    void rexW(bool wide) {
+        if(wide) byte(REX_W);
+    }
+    void modrmRegister(uint8_t r, Reg rm) {
+        byte(0xC0 | (r << 3) | reg(rm));
+    }
+    void modrmContext(uint8_t r, int32_t disp) {
+        byte(0x80 | (r << 3) | reg(Reg::RBX));
+        dword(uint32_t(disp));
+    }
+    void modrmRAX(uint8_t r) { byte((r << 3) | reg(Reg::RAX)); }
+
+  public:
+    const std::vector<uint8_t>& getCode() const { return code; }
+    size_t size() const { return code.size(); }
+
+    void byte(uint8_t b) { code.push_back(b); }
+    void dword(uint32_t d) {
+        for(int i = 0; i < 4; i++)
+            byte(uint8_t(d >> (8 * i)));
+    }
+    void qword(uint64_t q) {
+        for(int i = 0; i < 8; i++)
+            byte(uint8_t(q >> (8 * i)));
+    }
+
+    void push(Reg r) { byte(0x50 | reg(r)); }
+    void pop(Reg r) { byte(0x58 | reg(r)); }
+    void ret() { byte(0xC3); }
+
+    // mov dst, src
+    void mov(Reg dst, Reg src) {
+        byte(REX_W);
+        byte(0x89);
+        modrmRegister(reg(src), dst);
+    }
+    // mov dst, imm
+    void movImm(Reg dst, uint64_t imm) {
+        if(int64_t(imm) == int64_t(int32_t(imm))) {
+            byte(REX_W);
+            byte(0xC7);
+            modrmRegister(0, dst);
+            dword(uint32_t(imm));
+        } else {
+            byte(REX_W);
+            byte(0xB8 | reg(dst));
+            qword(imm);
+        }
+    }
+    // mov dst, [rbx+disp], only the low 32 bits when not wide
+    void load(Reg dst, int32_t disp, bool wide = true) {
+        rexW(wide);
+        byte(0x8B);
+        modrmContext(reg(dst), disp);
+    }
+    // mov [rbx+disp], src
+    void store(int32_t disp, Reg src) {
+        byte(REX_W);
+        byte(0x89);
+        modrmContext(reg(src), disp);
+    }
+    // op dst, src
+    void alu(Alu op, Reg dst, Reg src, bool wide = true) {
+        rexW(wide);
+        byte((uint8_t(op) << 3) | 0x1);
+        modrmRegister(reg(src), dst);
+    }
+    // op dst, [rbx+disp]
+    void alu(Alu op, Reg dst, int32_t disp, bool wide = true) {
+        rexW(wide);
+        byte((uint8_t(op) << 3) | 0x3);
+        modrmContext(reg(dst), disp);
+    }
+    // op dst, imm, the immediate is sign extended
+    void aluImm(Alu op, Reg dst, int32_t imm, bool wide = true) {
+        rexW(wide);
+        byte(0x81);
+        modrmRegister(uint8_t(op), dst);
+        dword(uint32_t(imm));
+    }
+    // cmp byte [rbx+disp], imm
+    void cmpByte(int32_t disp, uint8_t imm) {
+        byte(0x80);
+        modrmContext(uint8_t(Alu::CMP), disp);
+        byte(imm);
+    }
+    // test dst, src
+    void test(Reg dst, Reg src, bool wide = true) {
+        rexW(wide);
+        byte(0x85);
+        modrmRegister(reg(src), dst);
+    }
+    // imul dst, [rbx+disp]
+    void imul(Reg dst, int32_t disp, bool wide = true) {
+        rexW(wide);
+        byte(0x0F);
+        byte(0xAF);
+        modrmContext(reg(dst), disp);
+    }
+    // op dst, imm
+    void shiftImm(Shift op, Reg dst, uint8_t imm, bool wide = true) {
+        rexW(wide);
+        byte(0xC1);
+        modrmRegister(uint8_t(op), dst);
+        byte(imm);
+    }
+    // op dst, cl
+    void shiftCL(Shift op, Reg dst, bool wide = true) {
+        rexW(wide);
+        byte(0xD3);
+        modrmRegister(uint8_t(op), dst);
+    }
+    // movsxd dst, src32
+    void movsxd(Reg dst, Reg src) {
+        byte(REX_W);
+        byte(0x63);
+        modrmRegister(reg(dst), src);
+    }
+    // dst = cond ? 1 : 0, dst must be one of rax, rcx, rdx, or rbx
+    void setcc(Cond cond, Reg dst) {
+        byte(0x0F);
+        byte(0x90 | uint8_t(cond));
+        modrmRegister(0, dst);
+        // movzx dst32, dst8
+        byte(0x0F);
+        byte(0xB6);
+        modrmRegister(reg(dst), dst);
+    }
+
+    // rax = [rax], extended to 64 bits
+    void loadRAX(Access access) {
+        switch(access) {
+            case Access::BYTE:
+                byte(0x0F);
+                byte(0xB6);
+                break;
+            case Access::HALFWORD:
+                byte(0x0F);
+                byte(0xB7);
+                break;
+            case Access::WORD: byte(0x8B); break;
+            case Access::DOUBLEWORD:
+                byte(REX_W);
+                byte(0x8B);
+                break;
+            case Access::BYTE_SIGNED:
+                byte(REX_W);
+                byte(0x0F);
+                byte(0xBE);
+                break;
+            case Access::HALFWORD_SIGNED:
+                byte(REX_W);
+                byte(0x0F);
+                byte(0xBF);
+                break;
+            case Access::WORD_SIGNED:
+                byte(REX_W);
+                byte(0x63);
+                break;
+        }
+        modrmRAX(reg(Reg::RAX));
+    }
+    // [rax] = src, truncated to the access width
+    void storeRAX(Access access, Reg src) {
+        switch(access) {
+            case Access::BYTE:
+            case Access::BYTE_SIGNED: byte(0x88); break;
+            case Access::HALFWORD:
+            case Access::HALFWORD_SIGNED:
+                byte(0x66);
+                byte(0x89);
+                break;
+            case Access::WORD:
+            case Access::WORD_SIGNED: byte(0x89); break;
+            case Access::DOUBLEWORD:
+                byte(REX_W);
+                byte(0x89);
+                break;
+        }
+        modrmRAX(reg(src));
+    }
+
+    // call an absolute address, clobbers rax
+    void call(const void* fn) {
+        movImm(Reg::RAX, uint64_t(fn));
+        byte(0xFF);
+        modrmRegister(2, Reg::RAX);
+    }
+
+    // forward jumps, the returned label is bound to a later position with
+    // bind
+    Label jcc(Cond cond) {
+        byte(0x0F);
+        byte(0x80 | uint8_t(cond));
+        dword(0);
+        return code.size();
+    }
+    Label jmp() {
+        byte(0xE9);
+        dword(0);
+        return code.size();
+    }
+    void bind(Label label) {
+        uint32_t rel = uint32_t(code.size() - label);
+        std::memcpy(code.data() + label - 4, &rel, 4);
+    }
+};
+
+} // namespace x86_64
+} // namespace jit
+} // namespace hart
+
+#endif
@@ -1,7 +1,10 @@
 #include "syscall.h"
 
 #include "common/debug.h"
+#include "mem/fault-guard.h"
 
+#include <algorithm>
+#include <climits>
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/resource.h>
@@ -12,6 +15,7 @@
 #include <sys/utsname.h>
 #include <time.h>
 #include <unistd.h>
+#include <vector>
 
 #ifdef __EMSCRIPTEN__
     #include <syscall_arch.h>
@@ -21,11 +25,127 @@ namespace sys {
 
 namespace internal {
 
-// takes a simulated address and converts it to a real address
+// thrown when a syscall is handed memory the host cannot use, the guest gets
+// -EFAULT like it would from linux
+struct BadAddress {};
+
+// takes a simulated address and converts it to a real address, all n bytes
+// the host is going to read have to be allocated. the host never faults on
+// guest memory inside a syscall
+template <typename T>
+T convertToRealAddress(hart::HartState& hs, types::Address addr, size_t n) {
+    if(addr == 0) return T(0);
+    auto host = hs().mem().raw(addr, n);
+    if(host == nullptr) throw BadAddress();
+    return T(host);
+}
+// same as convertToRealAddress, for memory the host is going to write n bytes
+// to, so that any cached translation of that memory is dropped
 template <typename T>
-T convertToRealAddress(hart::HartState& hs, types::Address addr) {
-    if(addr) return T(hs().mem().raw(addr));
-    else return T(0);
+T convertToWritableAddress(hart::HartState& hs, types::Address addr, size_t n) {
+    auto host = convertToRealAddress<T>(hs, addr, n);
+    if(addr) hs().mem().markWritten(addr, n);
+    return host;
+}
+// a nul terminated string, which has to be allocated up to its nul
+const char* convertToRealString(hart::HartState& hs, types::Address addr) {
+    auto& mem = hs().mem();
+    auto host = mem.raw(addr);
+    if(host == nullptr) throw BadAddress();
+    for(auto at = addr;;) {
+        auto range = mem.getHostRange(at);
+        if(!range || range->host + (at - range->base) != host + (at - addr))
+            throw BadAddress();
+        auto left = range->base + range->size - at;
+        if(memchr(host + (at - addr), 0, left)) return (const char*)host;
+        at += left;
+    }
+}
+
+// mappings are made in whole pages of this size
+constexpr uint64_t GUEST_PAGE_SIZE = 4096;
+// brk grows the heap in place inside a host reservation of this size, so the
+// heap stays one region
+constexpr uint64_t BRK_RESERVE = uint64_t(1) << 30;
+
+uint64_t roundToPage(uint64_t n) {
+    return (n + GUEST_PAGE_SIZE - 1) & ~(GUEST_PAGE_SIZE - 1);
+}
+bool isPageAligned(types::Address addr) {
+    return (addr & (GUEST_PAGE_SIZE - 1)) == 0;
+}
+
+// true if every page of [addr, addr+length) holds allocated memory, which is
+// what linux calls mapped
+bool isMapped(hart::HartState& hs, types::Address addr, uint64_t length) {
+    for(auto page = addr; page - addr < length; page += GUEST_PAGE_SIZE) {
+        if(hs().mem().isFree(page, GUEST_PAGE_SIZE)) return false;
+    }
+    return true;
+}
+
+// put length bytes of zeroed memory at addr, replacing whatever was there if
+// fixed is set. otherwise addr is only a hint, and a free range in the mmap
+// area is used if it cannot be honored. returns the address or -errno
+int64_t mapMemory(
+    hart::HartState& hs,
+    types::Address addr,
+    uint64_t length,
+    bool fixed) {
+    auto& mem = hs().mem();
+    // the memory backend may not be able to place memory everywhere, the
+    // flat one only has its two windows
+    auto allocate = [&mem, length](types::Address at) {
+        try {
+            mem.allocate(at, length);
+            return true;
+        } catch(const mem::MemoryException&) {
+            return false;
+        }
+    };
+    if(fixed) {
+        // the old mapping stays if the new one cannot be made
+        if(!mem.canAllocate(addr, length)) return -ENOMEM;
+        mem.deallocate(addr, length);
+        return allocate(addr) ? int64_t(addr) : -ENOMEM;
+    }
+    if(addr != 0 && isPageAligned(addr) && mem.isFree(addr, length) &&
+       allocate(addr))
+        return int64_t(addr);
+    auto found = mem.findFree(
+        length,
+        hs().getMemLocation("mmap_start"),
+        hs().getMemLocation("mmap_end"));
+    if(!found || !allocate(*found)) return -ENOMEM;
+    return int64_t(*found);
+}
+
+// resize the mapping at old_addr, moving it if it cannot grow in place and
+// MREMAP_MAYMOVE is set. returns the new address or -errno
+int64_t remapMemory(
+    hart::HartState& hs,
+    types::Address old_addr,
+    uint64_t old_size,
+    uint64_t new_size,
+    int flags) {
+    auto& mem = hs().mem();
+    if(new_size <= old_size) {
+        mem.deallocate(old_addr + new_size, old_size - new_size);
+        return int64_t(old_addr);
+    }
+    // growing needs all of the old mapping, copying it would fault otherwise
+    if(!mem.isAllocated(old_addr, old_size)) return -EFAULT;
+    if(mem.isFree(old_addr + old_size, new_size - old_size)) {
+        auto grown =
+            mapMemory(hs, old_addr + old_size, new_size - old_size, true);
+        return grown < 0 ? grown : int64_t(old_addr);
+    }
+    if(!(flags & MREMAP_MAYMOVE)) return -ENOMEM;
+    auto new_addr = mapMemory(hs, 0, new_size, false);
+    if(new_addr < 0) return new_addr;
+    mem.copy(types::Address(new_addr), old_addr, old_size);
+    mem.deallocate(old_addr, old_size);
+    return new_addr;
 }
 
 int64_t
@@ -67,9 +187,11 @@ bool emulateSyscall(
             " arg5=",                                                          \
             common::Format::doubleword,                                        \
             hs().rf().GPR.rawreg(15).get());                                   \
-        do {                                                                   \
+        try {                                                                  \
             execution;                                                         \
-        } while(0);                                                            \
+        } catch(const BadAddress&) {                                           \
+            hs().rf().GPR[10] = -EFAULT;                                       \
+        }                                                                      \
         common::debug::logln(                                                  \
             common::debug::DebugType::SYSCALL,                                 \
             "Syscall " #name " returned with ",                                \
@@ -84,6 +206,8 @@ bool emulateSyscall(
 } // namespace internal
 
 void emulate(hart::HartState& hs) {
+    // a fault must not jump out of a syscall, so its accesses are checked
+    mem::FaultGuardSuspension suspension;
     uint64_t riscv64_syscall_number = hs().rf().GPR[17];
     uint64_t result;
 
@@ -134,10 +134,14 @@ Token Lexer::getKeyword() {
     if(t.lexeme == "STOP") t.token_type = TokenType::STOP;
     else if(t.lexeme == "PAUSE") t.token_type = TokenType::PAUSE;
     else if(t.lexeme == "RESUME") t.token_type = TokenType::RESUME;
+    else if(t.lexeme == "STEP") t.token_type = TokenType::STEP;
     else if(t.lexeme == "WATCH") t.token_type = TokenType::WATCH;
     else if(t.lexeme == "DUMP") t.token_type = TokenType::DUMP;
     else if(t.lexeme == "DISASM") t.token_type = TokenType::DISASM;
     else if(t.lexeme == "SET") t.token_type = TokenType::SET;
+    else if(t.lexeme == "SNAPSHOT") t.token_type = TokenType::SNAPSHOT;
+    else if(t.lexeme == "RESTORE") t.token_type = TokenType::RESTORE;
+    else if(t.lexeme == "DIFF") t.token_type = TokenType::DIFF;
     else if(t.lexeme == "IF") t.token_type = TokenType::IF;
     else if(t.lexeme == "ON") t.token_type = TokenType::ON;
     else if(event::isEventSubsystemType(t.lexeme))
@@ -22,10 +22,14 @@
     F(STOP)                                                                    \
     F(PAUSE)                                                                   \
     F(RESUME)                                                                  \
+    F(STEP)                                                                    \
     F(WATCH)                                                                   \
     F(DUMP)                                                                    \
     F(DISASM)                                                                  \
     F(SET)                                                                     \
+    F(SNAPSHOT)                                                                \
+    F(RESTORE)                                                                 \
+    F(DIFF)                                                                    \
     F(IF)                                                                      \
     F(ON)
 
@@ -188,6 +188,19 @@ action::ActionPtr Parser::parse_action() {
         expect(TokenType::RESUME);
         ParenParserRAII ppRAII(this);
         return std::make_shared<action::Resume>();
+    } else if(lexer.peek().token_type == TokenType::STEP) {
+        expect(TokenType::STEP);
+        ParenParserRAII ppRAII(this);
+        // the number of instructions is optional, defaulting to 1
+        auto tt = lexer.peek().token_type;
+        if(tt == TokenType::END_OF_FILE || tt == TokenType::SEMICOLON ||
+           tt == TokenType::COMMA || tt == TokenType::RPAREN ||
+           tt == TokenType::IF || tt == TokenType::ON) {
+            return std::make_shared<action::Step>(
+                std::make_shared<command::NumberExpr>(1));
+        }
+        auto expr = parse_expr();
+        return std::make_shared<action::Step>(expr);
     } else if(lexer.peek().token_type == TokenType::DISASM) {
         expect(TokenType::DISASM);
         ParenParserRAII ppRAII(this);
@@ -215,6 +228,20 @@ action::ActionPtr Parser::parse_action() {
         expect(TokenType::EQUALS);
         auto rhs = parse_expr();
         return std::make_shared<action::Set>(lhs, rhs);
+    } else if(lexer.peek().token_type == TokenType::SNAPSHOT) {
+        expect(TokenType::SNAPSHOT);
+        ParenParserRAII ppRAII(this);
+        return std::make_shared<action::Snapshot>();
+    } else if(lexer.peek().token_type == TokenType::RESTORE) {
+        expect(TokenType::RESTORE);
+        ParenParserRAII ppRAII(this);
+        auto expr = parse_expr();
+        return std::make_shared<action::Restore>(expr);
+    } else if(lexer.peek().token_type == TokenType::DIFF) {
+        expect(TokenType::DIFF);
+        ParenParserRAII ppRAII(this);
+        auto expr = parse_expr();
+        return std::make_shared<action::Diff>(expr);
     } else throw ParseException("Unknown action: " + lexer.peek().getString());
 }
 
@@ -8,6 +8,9 @@
 #include "hart/isa/rf.h"
 #include "ishell/parser/parser.h"
 
+#include <algorithm>
+#include <cctype>
+#include <sstream>
 #include <termios.h>
 #include <unistd.h>
 
@@ -123,6 +126,9 @@ void Repl::execute() {
 
     while(1) {
         if(hs->isPaused()) {
+            // commands may change memory and the block cache, which the hart
+            // may still be using until it parks
+            if(!hs->waitUntilParked()) continue;
             std::string input;
             auto res = lineInput.get(input, ">>> ");
             if(!res) {
@@ -130,17 +136,23 @@ void Repl::execute() {
                 hs->stop();
                 continue;
             }
+            if(handleInstalled(input)) continue;
             try {
                 auto c = parser.parse(input, command::CommandContext::REPL);
                 c->setHS(hs);
                 c->install();
                 c->doit(&std::cout);
+                if(auto cc =
+                       std::dynamic_pointer_cast<command::CallbackCommand>(c)) {
+                    std::cout << "Installed as " << next_number << "\n";
+                    installed.push_back({next_number++, cc});
+                }
             } catch(const ishell::parser::ParseException& pe) {
                 std::cerr << "Invalid command\n";
             }
         } else if(hs->isRunning()) {
-            // keep running
-            std::this_thread::yield();
+            // sleep until the hart pauses or stops
+            hs->waitWhile(hart::ExecutionState::RUNNING);
         } else {
             break;
         }
@@ -148,6 +160,47 @@ void Repl::execute() {
     sync_point.signal();
 }
 
+bool Repl::handleInstalled(const std::string& input) {
+    std::istringstream ss(input);
+    std::vector<std::string> words;
+    for(std::string w; ss >> w;)
+        words.push_back(w);
+    if(words.empty()) return false;
+    auto keyword = common::utils::toupper(words[0]);
+    if(keyword != "UNWATCH" && keyword != "DISABLE" && keyword != "ENABLE")
+        return false;
+
+    // only the shell knows what it installed, so it removes them itself. the
+    // hart goes back to full speed once nothing else is listening
+    if(words.size() == 1 && keyword == "UNWATCH") {
+        installed.erase(
+            std::remove_if(
+                installed.begin(),
+                installed.end(),
+                [](const auto& i) { return i.command->isWatch(); }),
+            installed.end());
+        return true;
+    }
+    auto isDigit = [](unsigned char c) { return std::isdigit(c) != 0; };
+    if(words.size() != 2 || words[1].size() > 9 ||
+       !std::all_of(words[1].begin(), words[1].end(), isDigit)) {
+        std::cerr << "Invalid command\n";
+        return true;
+    }
+    size_t number = std::stoul(words[1]);
+    auto it = std::find_if(
+        installed.begin(),
+        installed.end(),
+        [number](const auto& i) { return i.number == number; });
+    if(it == installed.end()) {
+        std::cerr << "Nothing is installed as " << number << "\n";
+        return true;
+    }
+    if(keyword == "UNWATCH") installed.erase(it);
+    else it->command->setEnabled(keyword == "ENABLE");
+    return true;
+}
+
 } // namespace ishell
 
 /*
@@ -3,12 +3,17 @@
 
 #include "common/threading/syncpoint.h"
 
+#include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace hart {
 class HartState;
 }
+namespace command {
+class CallbackCommand;
+}
 
 namespace ishell {
 
@@ -17,6 +22,15 @@ class Repl {
     hart::HartState* hs;
     common::threading::syncpoint sync_point;
     std::thread execution_thread;
+    // commands from the shell that stay installed, such as watches. their
+    // listeners go away with them. each is numbered for unwatch, disable,
+    // and enable, and keeps its number until it is removed
+    struct Installed {
+        size_t number;
+        std::shared_ptr<command::CallbackCommand> command;
+    };
+    std::vector<Installed> installed;
+    size_t next_number = 1;
 
   public:
     Repl(hart::HartState* hs);
@@ -28,6 +42,9 @@ class Repl {
     void execute();
     // void handleLine(const std::string& );
     std::string getNextLine();
+    // run input if it is one of the commands for what the shell installed,
+    // returns false if it is not
+    bool handleInstalled(const std::string& input);
 };
 
 } // namespace ishell
@@ -0,0 +1,63 @@
+#ifndef ZIRCON_MEM_ADDRESS_RANGES_H_
+#define ZIRCON_MEM_ADDRESS_RANGES_H_
+
+#include "hart/types.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace mem {
+
+// a set of addresses, kept as sorted [lower, upper) intervals that neither
+// overlap nor touch
+class AddressRanges {
+  public:
+    using Range = std::pair<types::Address, types::Address>;
+
+  private:
+    std::vector<Range> ranges;
+
+  public:
+    AddressRanges() = default;
+    AddressRanges(types::Address addr, uint64_t size) { add(addr, size); }
+
+    // add [addr, addr+size), clamped to the end of the address space
+    void add(types::Address addr, uint64_t size) {
+        if(size == 0) return;
+        auto lower = addr;
+        auto upper = addr + size < addr ? ~types::Address(0) : addr + size;
+        // the first range that ends at or after lower can be merged with
+        auto first = std::lower_bound(
+            ranges.begin(),
+            ranges.end(),
+            lower,
+            [](const Range& r, types::Address a) { return r.second < a; });
+        auto last = first;
+        while(last != ranges.end() && last->first <= upper) {
+            lower = std::min(lower, last->first);
+            upper = std::max(upper, last->second);
+            last++;
+        }
+        first = ranges.erase(first, last);
+        ranges.insert(first, {lower, upper});
+    }
+    // true if any byte of [addr, addr+n) is in the set
+    bool overlaps(types::Address addr, uint64_t n) const {
+        if(n == 0) return false;
+        auto it = std::upper_bound(
+            ranges.begin(),
+            ranges.end(),
+            addr,
+            [](types::Address a, const Range& r) { return a < r.second; });
+        return it != ranges.end() &&
+               (it->first <= addr || it->first - addr < n);
+    }
+    bool empty() const { return ranges.empty(); }
+    auto begin() const { return ranges.begin(); }
+    auto end() const { return ranges.end(); }
+};
+
+} // namespace mem
+
+#endif
@@ -0,0 +1,68 @@
+#include "fault-guard.h"
+
+#include <mutex>
+
+namespace mem {
+
+// the innermost guard on each thread
+static thread_local FaultGuard* active_guard = nullptr;
+static struct sigaction previous_action;
+
+void FaultGuard::handler(int sig, siginfo_t* info, void* context) {
+    auto guard = active_guard;
+    if(guard && guard->mi.flat) {
+        // an access touches at most two pages
+        auto& mi = guard->mi;
+        if(mi.lent_count < mi.lent_pages.size()) {
+            if(auto page = mi.flat->lend(info->si_addr)) {
+                mi.lent_pages[mi.lent_count++] = *page;
+                mi.faulted.store(true, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+    // not a guest access, let whoever was there before deal with it
+    if(previous_action.sa_flags & SA_SIGINFO) {
+        previous_action.sa_sigaction(sig, info, context);
+    } else if(
+        previous_action.sa_handler == SIG_DFL ||
+        previous_action.sa_handler == SIG_IGN) {
+        // the faulting instruction runs again and gets the old behavior
+        sigaction(SIGSEGV, &previous_action, nullptr);
+    } else {
+        previous_action.sa_handler(sig);
+    }
+}
+
+FaultGuard::FaultGuard(MemoryImage& mi)
+    : mi(mi), previous(active_guard), was_guarded(mi.guarded) {
+    static std::once_flag installed;
+    std::call_once(installed, []() {
+        struct sigaction action = {};
+        action.sa_sigaction = &FaultGuard::handler;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGSEGV, &action, &previous_action);
+    });
+    active_guard = this;
+    mi.guarded = true;
+}
+
+FaultGuard::~FaultGuard() {
+    // only accesses through BareView take pages back themselves
+    if(mi.faulted) mi.returnLentPages();
+    mi.guarded = was_guarded;
+    active_guard = previous;
+}
+
+FaultGuardSuspension::FaultGuardSuspension() : suspended(active_guard) {
+    if(suspended) suspended->mi.guarded = false;
+    active_guard = nullptr;
+}
+
+FaultGuardSuspension::~FaultGuardSuspension() {
+    if(suspended) suspended->mi.guarded = true;
+    active_guard = suspended;
+}
+
+} // namespace mem
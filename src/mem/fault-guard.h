@@ -0,0 +1,47 @@
+#ifndef ZIRCON_MEM_FAULT_GUARD_H_
+#define ZIRCON_MEM_FAULT_GUARD_H_
+
+#include "memory-image.h"
+
+#include <csignal>
+
+namespace mem {
+
+// while alive, accesses through MemoryImage::BareView skip their bounds
+// checks, and a SIGSEGV on this thread that lands in the image's flat space
+// does not kill the simulator. the faulting host page is made accessible so
+// the access can finish, and the access then throws OutOfBoundsException
+// like a checked one would. the image must use the flat backend
+class FaultGuard {
+  private:
+    MemoryImage& mi;
+    FaultGuard* previous;
+    bool was_guarded;
+
+    static void handler(int sig, siginfo_t* info, void* context);
+    friend class FaultGuardSuspension;
+
+  public:
+    FaultGuard(MemoryImage& mi);
+    ~FaultGuard();
+    FaultGuard(const FaultGuard&) = delete;
+    FaultGuard& operator=(const FaultGuard&) = delete;
+};
+
+// while alive, the FaultGuard active on this thread is set aside, so accesses
+// through MemoryImage::BareView are checked again and faults are not caught.
+// for code that hands host pointers to the host, like syscalls
+class FaultGuardSuspension {
+  private:
+    FaultGuard* suspended;
+
+  public:
+    FaultGuardSuspension();
+    ~FaultGuardSuspension();
+    FaultGuardSuspension(const FaultGuardSuspension&) = delete;
+    FaultGuardSuspension& operator=(const FaultGuardSuspension&) = delete;
+};
+
+} // namespace mem
+
+#endif
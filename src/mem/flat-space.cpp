@@ -0,0 +1,115 @@
+#include "flat-space.h"
+
+#include "memory-image.h"
+
+#if !defined(__EMSCRIPTEN__)
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+namespace mem {
+
+#if !defined(__EMSCRIPTEN__)
+
+std::unique_ptr<FlatSpace> FlatSpace::reserve() {
+    // nothing is backed until it is committed, so reserving the whole range
+    // costs only address space
+    auto size = MASK + 1 + MemoryImage::HUGE_PAGE_SIZE;
+    void* ptr = mmap(
+        nullptr,
+        size,
+        PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+        -1,
+        0);
+    if(ptr == MAP_FAILED) return nullptr;
+    auto base = (uintptr_t(ptr) + MemoryImage::HUGE_PAGE_SIZE - 1) &
+                ~uintptr_t(MemoryImage::HUGE_PAGE_SIZE - 1);
+    return std::unique_ptr<FlatSpace>(new FlatSpace((uint8_t*)base, ptr, size));
+}
+
+FlatSpace::~FlatSpace() { munmap(reserved, reserved_size); }
+
+uint64_t FlatSpace::pageSize() { return uint64_t(sysconf(_SC_PAGESIZE)); }
+
+uint8_t* FlatSpace::commit(types::Address addr, uint64_t size) {
+    if(!contains(addr, size)) {
+        std::stringstream ss;
+        ss << "0x" << std::hex << addr << " of size 0x" << size
+           << " is outside of the flat address space";
+        throw MemoryException("Flat", ss.str());
+    }
+    // mprotect works on whole host pages
+    auto page_size = uintptr_t(sysconf(_SC_PAGESIZE));
+    auto lower = uintptr_t(host(addr)) & ~(page_size - 1);
+    auto upper = (uintptr_t(host(addr)) + size + page_size - 1) &
+                 ~(page_size - 1);
+    if(mprotect((void*)lower, upper - lower, PROT_READ | PROT_WRITE) != 0) {
+        throw MemoryException("Flat", "could not commit memory");
+    }
+    return host(addr);
+}
+
+void FlatSpace::decommit(types::Address addr, uint64_t size) {
+    // pages shared with memory that is still allocated are only zeroed
+    auto page_size = uintptr_t(sysconf(_SC_PAGESIZE));
+    auto ptr = host(addr);
+    auto lower = (uintptr_t(ptr) + page_size - 1) & ~(page_size - 1);
+    auto upper = (uintptr_t(ptr) + size) & ~(page_size - 1);
+    if(lower >= upper) {
+        std::memset(ptr, 0, size);
+        return;
+    }
+    std::memset(ptr, 0, lower - uintptr_t(ptr));
+    std::memset((void*)upper, 0, uintptr_t(ptr) + size - upper);
+    // mapping over the pages drops their contents along with the access
+    mmap(
+        (void*)lower,
+        upper - lower,
+        PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+        -1,
+        0);
+}
+
+std::optional<types::Address> FlatSpace::lend(const void* host) {
+    auto page = (void*)(uintptr_t(host) & ~uintptr_t(page_size - 1));
+    auto addr = guest(page);
+    if(!addr || mprotect(page, page_size, PROT_READ | PROT_WRITE) != 0)
+        return std::nullopt;
+    return addr;
+}
+
+void FlatSpace::adviseHugePages(
+    [[maybe_unused]] types::Address addr,
+    [[maybe_unused]] uint64_t size) {
+    #if defined(MADV_HUGEPAGE)
+    if(!contains(addr, size)) return;
+    // madvise works on whole host pages
+    auto page_size = uintptr_t(sysconf(_SC_PAGESIZE));
+    auto lower = uintptr_t(host(addr)) & ~(page_size - 1);
+    auto upper = (uintptr_t(host(addr)) + size + page_size - 1) &
+                 ~(page_size - 1);
+    madvise((void*)lower, upper - lower, MADV_HUGEPAGE);
+    #endif
+}
+
+#else
+
+std::unique_ptr<FlatSpace> FlatSpace::reserve() { return nullptr; }
+void FlatSpace::adviseHugePages(types::Address, uint64_t) {}
+FlatSpace::~FlatSpace() {}
+uint64_t FlatSpace::pageSize() { return 4096; }
+uint8_t* FlatSpace::commit(types::Address addr, uint64_t) {
+    return host(addr);
+}
+void FlatSpace::decommit(types::Address addr, uint64_t size) {
+    std::memset(host(addr), 0, size);
+}
+std::optional<types::Address> FlatSpace::lend(const void*) {
+    return std::nullopt;
+}
+
+#endif
+
+} // namespace mem
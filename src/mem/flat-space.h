@@ -0,0 +1,85 @@
+#ifndef ZIRCON_MEM_FLAT_SPACE_H_
+#define ZIRCON_MEM_FLAT_SPACE_H_
+
+#include "hart/types.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+namespace mem {
+
+// one reserved range of host address space that guest memory is placed in,
+// so a guest address is turned into a host address with a mask and an add.
+// the range holds two windows, the low one for the program and heap and a
+// high one for the stack, which are folded together by masking off the upper
+// bits of the guest address
+class FlatSpace {
+  public:
+    static constexpr unsigned WINDOW_BITS = 35;
+    static constexpr types::Address WINDOW_SIZE = types::Address(1)
+                                                  << WINDOW_BITS;
+    static constexpr types::Address LOW_BASE = 0;
+    static constexpr types::Address HIGH_BASE =
+        (types::Address(1) << 63) - WINDOW_SIZE;
+    static constexpr types::Address MASK = (WINDOW_SIZE << 1) - 1;
+
+  private:
+    uint8_t* base;
+    // the host range that was reserved, base is aligned within it
+    void* reserved;
+    uint64_t reserved_size;
+    // pageSize(), looked up once so that lend need not
+    uint64_t page_size;
+
+    FlatSpace(uint8_t* base, void* reserved, uint64_t reserved_size)
+        : base(base), reserved(reserved), reserved_size(reserved_size),
+          page_size(pageSize()) {}
+
+  public:
+    // reserves the host range, nullptr if the host cannot spare it
+    static std::unique_ptr<FlatSpace> reserve();
+    ~FlatSpace();
+    FlatSpace(const FlatSpace&) = delete;
+    FlatSpace& operator=(const FlatSpace&) = delete;
+
+    static bool contains(types::Address addr, uint64_t size = 1) {
+        auto inWindow = [addr, size](types::Address window) {
+            return addr >= window && size <= WINDOW_SIZE &&
+                   addr - window <= WINDOW_SIZE - size;
+        };
+        return inWindow(LOW_BASE) || inWindow(HIGH_BASE);
+    }
+    // the host address for addr, which must be contained. only memory that
+    // has been committed may be accessed through it
+    uint8_t* host(types::Address addr) const { return base + (addr & MASK); }
+    // the guest address for a host address, nullptr if it is not in the
+    // reserved range
+    std::optional<types::Address> guest(const void* host) const {
+        auto ptr = static_cast<const uint8_t*>(host);
+        if(ptr < base || ptr > base + MASK) return std::nullopt;
+        types::Address offset = ptr - base;
+        if(offset < WINDOW_SIZE) return LOW_BASE + offset;
+        else return HIGH_BASE + (offset - WINDOW_SIZE);
+    }
+    // commit and decommit work in host pages of this size
+    static uint64_t pageSize();
+    // make [addr, addr+size) accessible, returning its host address. the rest
+    // of the host pages it touches become accessible too
+    uint8_t* commit(types::Address addr, uint64_t size);
+    // zero [addr, addr+size), the host pages wholly inside it become
+    // inaccessible again
+    void decommit(types::Address addr, uint64_t size);
+    // make the host page holding host accessible, so that an access which
+    // faulted on it can run to completion, returning the guest address of
+    // the page. decommit makes it inaccessible again. only makes a system
+    // call, so it may be called from a signal handler
+    std::optional<types::Address> lend(const void* host);
+    // ask for [addr, addr+size) to be backed by transparent huge pages, base
+    // is aligned so guest and host huge pages line up
+    void adviseHugePages(types::Address addr, uint64_t size);
+};
+
+} // namespace mem
+
+#endif
@@ -1,30 +1,388 @@
 #include "memory-image.h"
 
-template <> uint8_t mem::MemoryImage::MemoryCellProxy<uint8_t>::read() {
-    return mr().byte(addr);
+#include <fstream>
+
+#if !defined(__EMSCRIPTEN__)
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+uint8_t* mem::MemoryImage::mapAnonymous(
+    [[maybe_unused]] uint64_t size,
+    [[maybe_unused]] bool huge) {
+#if !defined(__EMSCRIPTEN__)
+    // huge pages need an aligned range, so map extra and trim it off
+    auto extra = huge ? HUGE_PAGE_SIZE : 0;
+    void* ptr = mmap(
+        nullptr,
+        size + extra,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+        -1,
+        0);
+    if(ptr == MAP_FAILED) return nullptr;
+    if(!huge) return (uint8_t*)ptr;
+    auto lower = uintptr_t(ptr);
+    auto aligned = (lower + HUGE_PAGE_SIZE - 1) & ~uintptr_t(HUGE_PAGE_SIZE - 1);
+    if(aligned != lower) munmap(ptr, aligned - lower);
+    if(aligned + size != lower + size + extra)
+        munmap((void*)(aligned + size), lower + extra - aligned);
+    #if defined(MADV_HUGEPAGE)
+    madvise((void*)aligned, size, MADV_HUGEPAGE);
+    #endif
+    return (uint8_t*)aligned;
+#else
+    return nullptr;
+#endif
+}
+void mem::MemoryImage::unmapAnonymous(
+    [[maybe_unused]] uint8_t* ptr,
+    [[maybe_unused]] uint64_t size) {
+#if !defined(__EMSCRIPTEN__)
+    munmap(ptr, size);
+#endif
+}
+
+uint8_t* mem::MemoryImage::translateSlow(
+    Access access,
+    types::Address addr,
+    size_t n) {
+    auto mr = getMemoryRegion(addr);
+    // an access that runs off the end of its region is out of bounds as a
+    // whole, like it is when the flat backend faults on it
+    if(mr == nullptr || addr + n > mr->address + mr->size) return nullptr;
+    if(access == Access::STORE && tracking) trackWrite(addr, n);
+    // only pages wholly inside the region can be cached, any address in them
+    // is then known to be allocated. watched pages are never cached, see
+    // isWatched
+    auto page = PageTable<MemoryRegion>::pageOf(addr);
+    if(watching(access) && page_table.testBit(watchBit(access), page, 1))
+        return mr->raw(addr);
+    if(mr->address <= page &&
+       page + PageTable<MemoryRegion>::PAGE_SIZE <= mr->address + mr->size) {
+        auto& entry = tlbEntry(access, page);
+        entry.page = page;
+        entry.host = mr->buffer + (page - mr->address);
+    }
+    return mr->raw(addr);
+}
+
+bool mem::MemoryImage::enableHugePages() {
+#if !defined(__EMSCRIPTEN__) && defined(MADV_HUGEPAGE)
+    // huge pages can be turned off for the whole host
+    std::ifstream thp("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string modes;
+    if(std::getline(thp, modes) &&
+       modes.find("[never]") != std::string::npos)
+        return false;
+    huge_pages = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void mem::MemoryImage::releaseAnonymous(uint8_t* ptr, uint64_t size) {
+#if !defined(__EMSCRIPTEN__)
+    // only whole host pages can be handed back, the edges are zeroed by hand
+    auto page_size = uintptr_t(sysconf(_SC_PAGESIZE));
+    auto lower = (uintptr_t(ptr) + page_size - 1) & ~(page_size - 1);
+    auto upper = (uintptr_t(ptr) + size) & ~(page_size - 1);
+    if(lower < upper) {
+        std::memset(ptr, 0, lower - uintptr_t(ptr));
+        madvise((void*)lower, upper - lower, MADV_DONTNEED);
+        std::memset((void*)upper, 0, uintptr_t(ptr) + size - upper);
+        return;
+    }
+#endif
+    std::memset(ptr, 0, size);
 }
-template <> uint16_t mem::MemoryImage::MemoryCellProxy<uint16_t>::read() {
-    return mr().halfword(addr);
+
+void mem::MemoryImage::deallocate(types::Address addr, uint64_t size) {
+    if(size == 0) return;
+    auto end = addr + size;
+    auto it = memory_map.lower_bound(addr);
+    if(it != memory_map.begin() && std::prev(it)->second.end() > addr) it--;
+    bool deallocated = false;
+    while(it != memory_map.end() && it->second.address < end) {
+        if(tracking) {
+            auto& region = it->second;
+            auto lower = std::max(addr, region.address);
+            trackWrite(lower, std::min(end, region.end()) - lower);
+        }
+        auto mr = it->second;
+        unmapPages(it->second);
+        it = memory_map.erase(it);
+
+        // the part of the region that goes away is zeroed, so the buffer is
+        // zero past the end of what is left
+        auto lower = std::max(addr, mr.address);
+        auto upper = std::min(end, mr.end());
+        auto host = mr.buffer + (lower - mr.address);
+        if(flat) flat->decommit(lower, upper - lower);
+        else if(mr.mapped) releaseAnonymous(host, upper - lower);
+        else std::memset(host, 0, upper - lower);
+        allocated_bytes -= upper - lower;
+
+        // the piece before the hole can still grow into it, unless the piece
+        // after it is in the way
+        if(mr.address < lower) {
+            auto& left = memory_map
+                             .try_emplace(
+                                 mr.address,
+                                 mr.address,
+                                 lower - mr.address,
+                                 mr.buffer,
+                                 upper < mr.end() ? lower - mr.address
+                                                  : mr.capacity,
+                                 mr.storage,
+                                 mr.mapped)
+                             .first->second;
+            mapPages(left, left.address, left.size);
+        }
+        if(upper < mr.end()) {
+            auto offset = upper - mr.address;
+            auto& right = memory_map
+                              .try_emplace(
+                                  upper,
+                                  upper,
+                                  mr.end() - upper,
+                                  mr.buffer + offset,
+                                  mr.capacity - offset,
+                                  mr.storage,
+                                  mr.mapped)
+                              .first->second;
+            mapPages(right, right.address, right.size);
+        }
+        deallocated = true;
+    }
+    if(!deallocated) return;
+    if(flat) markPartialPages(addr, size);
+    // code that was translated from the range is gone with it
+    markWritten(addr, size);
+    flushTLB();
+    event_deallocation(addr, size);
 }
-template <> uint32_t mem::MemoryImage::MemoryCellProxy<uint32_t>::read() {
-    return mr().word(addr);
+
+void mem::MemoryImage::returnLentPages() {
+    for(unsigned i = 0; i < lent_count; i++) {
+        flat->decommit(lent_pages[i], FlatSpace::pageSize());
+    }
+    lent_count = 0;
+    faulted = false;
 }
-template <> uint64_t mem::MemoryImage::MemoryCellProxy<uint64_t>::read() {
-    return mr().doubleword(addr);
+
+void mem::MemoryImage::raiseFault(types::Address addr) {
+    returnLentPages();
+    throw OutOfBoundsException(addr);
 }
 
-template <> void mem::MemoryImage::MemoryCellProxy<uint8_t>::write(uint8_t v) {
-    mr().byte(addr) = v;
+void mem::MemoryImage::markPartialPages(types::Address addr, uint64_t size) {
+    constexpr auto PAGE_SIZE = PageTable<MemoryRegion>::PAGE_SIZE;
+    auto host_page = std::max(FlatSpace::pageSize(), PAGE_SIZE);
+    // the host pages wholly inside the range are now either all allocated or
+    // all free
+    page_table.clearBit(PageBit::PARTIAL, addr, size);
+    for(auto edge : {addr, addr + size - 1}) {
+        auto lower = edge & ~(host_page - 1);
+        uint64_t allocated = 0;
+        for(auto page = lower; page < lower + host_page; page += PAGE_SIZE) {
+            forEachChunk(page, [&allocated](auto, auto, auto n) {
+                allocated += n;
+            });
+        }
+        if(allocated != 0 && allocated != host_page)
+            page_table.setBit(PageBit::PARTIAL, lower, host_page);
+        else page_table.clearBit(PageBit::PARTIAL, lower, host_page);
+    }
 }
-template <>
-void mem::MemoryImage::MemoryCellProxy<uint16_t>::write(uint16_t v) {
-    mr().halfword(addr) = v;
+
+std::optional<types::Address> mem::MemoryImage::findFree(
+    uint64_t size,
+    types::Address lower,
+    types::Address upper) const {
+    constexpr auto PAGE_SIZE = PageTable<MemoryRegion>::PAGE_SIZE;
+    auto pageUp = [](types::Address a) {
+        return (a + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    };
+    auto pageDown = [](types::Address a) { return a & ~(PAGE_SIZE - 1); };
+    size = pageUp(size);
+    // walk the gaps between regions from the top down
+    auto top = pageDown(upper);
+    auto it = memory_map.lower_bound(upper);
+    while(true) {
+        auto bottom = lower;
+        if(it != memory_map.begin())
+            bottom = std::max(lower, pageUp(std::prev(it)->second.end()));
+        if(top >= bottom && top - bottom >= size) return pageDown(top - size);
+        if(it == memory_map.begin()) return std::nullopt;
+        it--;
+        if(it->second.address <= lower) return std::nullopt;
+        top = std::min(top, pageDown(it->second.address));
+    }
+}
+
+void mem::MemoryImage::readBlock(types::Address addr, void* dst, uint64_t n) {
+    auto out = static_cast<uint8_t*>(dst);
+    forEachRun(addr, n, [out, addr](auto a, auto host, auto len) {
+        std::memcpy(out + (a - addr), host, len);
+    });
+    event_block_read(addr, n);
 }
-template <>
-void mem::MemoryImage::MemoryCellProxy<uint32_t>::write(uint32_t v) {
-    mr().word(addr) = v;
+
+void mem::MemoryImage::writeBlock(
+    types::Address addr,
+    const void* src,
+    uint64_t n) {
+    auto in = static_cast<const uint8_t*>(src);
+    forEachRun(addr, n, [this, in, addr](auto a, auto host, auto len) {
+        markWritten(a, len);
+        std::memcpy(host, in + (a - addr), len);
+    });
+    event_block_write(addr, n);
 }
-template <>
-void mem::MemoryImage::MemoryCellProxy<uint64_t>::write(uint64_t v) {
-    mr().doubleword(addr) = v;
+
+void mem::MemoryImage::fill(types::Address addr, uint8_t value, uint64_t n) {
+    forEachRun(addr, n, [this, value](auto a, auto host, auto len) {
+        markWritten(a, len);
+        std::memset(host, value, len);
+    });
+    event_block_write(addr, n);
+}
+
+void mem::MemoryImage::copy(
+    types::Address dst,
+    types::Address src,
+    uint64_t n) {
+    if(dst > src && dst - src < n) {
+        // copying forwards would overwrite the source before it is read
+        std::vector<uint8_t> buffer(n);
+        readBlock(src, buffer.data(), n);
+        writeBlock(dst, buffer.data(), n);
+        return;
+    }
+    auto start = dst;
+    forEachRun(src, n, [this, &dst](auto, auto from, auto len) {
+        forEachRun(dst, len, [this, &from](auto a, auto to, auto chunk) {
+            markWritten(a, chunk);
+            std::memmove(to, from, chunk);
+            from += chunk;
+        });
+        dst += len;
+    });
+    event_block_read(src, n);
+    event_block_write(start, n);
+}
+
+std::shared_ptr<mem::Snapshot::Page>
+mem::MemoryImage::copyPage(types::Address page) const {
+    auto copy = std::make_shared<Snapshot::Page>();
+    copy->fill(0);
+    forEachChunk(page, [&copy, page](auto addr, auto host, auto n) {
+        std::memcpy(copy->data() + (addr - page), host, n);
+    });
+    return copy;
+}
+
+void mem::MemoryImage::trackWrite(types::Address addr, uint64_t n) {
+    if(dirty_tracking) page_table.setBit(PageBit::DIRTY, addr, n);
+    if(!snapshots.empty()) savePages(addr, n);
+}
+
+void mem::MemoryImage::savePages(types::Address addr, uint64_t n) {
+    if(snapshots.back().expired()) {
+        snapshots.erase(
+            std::remove_if(
+                snapshots.begin(),
+                snapshots.end(),
+                [](auto& s) { return s.expired(); }),
+            snapshots.end());
+        tracking = dirty_tracking || !snapshots.empty();
+        if(snapshots.empty()) return;
+    }
+    auto last = PageTable<MemoryRegion>::pageOf(addr + n - 1);
+    for(auto page = PageTable<MemoryRegion>::pageOf(addr);;
+        page += Snapshot::PAGE_SIZE) {
+        // newer snapshots are missing the page until one that has it
+        std::shared_ptr<const Snapshot::Page> copy;
+        for(auto it = snapshots.rbegin(); it != snapshots.rend(); it++) {
+            auto s = it->lock();
+            if(!s) continue;
+            if(s->pages.count(page)) break;
+            if(!copy) copy = copyPage(page);
+            s->pages.emplace(page, copy);
+        }
+        if(page == last) break;
+    }
+}
+
+std::shared_ptr<mem::Snapshot> mem::MemoryImage::snapshot() {
+    auto s = std::make_shared<Snapshot>();
+    for(const auto& [address, mr] : memory_map) {
+        s->layout.emplace_back(address, mr.size);
+    }
+    snapshots.erase(
+        std::remove_if(
+            snapshots.begin(),
+            snapshots.end(),
+            [](auto& other) { return other.expired(); }),
+        snapshots.end());
+    snapshots.push_back(s);
+    tracking = true;
+    // stores have to miss the TLB once more, so pages get saved
+    tlb[size_t(Access::STORE)] = {};
+    return s;
+}
+
+namespace {
+using Ranges = std::vector<std::pair<types::Address, uint64_t>>;
+// the parts of a that are not in b, both in address order and not overlapping
+Ranges subtract(const Ranges& a, const Ranges& b) {
+    Ranges result;
+    auto other = b.begin();
+    for(auto [addr, size] : a) {
+        auto end = addr + size;
+        while(other != b.end() && other->first + other->second <= addr)
+            other++;
+        for(auto it = other; it != b.end() && it->first < end; it++) {
+            if(it->first > addr) result.emplace_back(addr, it->first - addr);
+            addr = std::max(addr, it->first + it->second);
+        }
+        if(addr < end) result.emplace_back(addr, end - addr);
+    }
+    return result;
+}
+} // namespace
+
+void mem::MemoryImage::restore(const Snapshot& s) {
+    Ranges layout;
+    for(const auto& [address, mr] : memory_map) {
+        layout.emplace_back(address, mr.size);
+    }
+    for(auto [addr, size] : subtract(layout, s.layout)) {
+        deallocate(addr, size);
+    }
+    for(auto [addr, size] : subtract(s.layout, layout)) {
+        allocate(addr, size);
+    }
+    // pages that were not saved have not been written since
+    for(const auto& [page, copy] : s.pages) {
+        auto& saved = *copy;
+        forEachChunk(page, [this, &saved, page](auto addr, auto host, auto n) {
+            markWritten(addr, n);
+            std::memcpy(
+                const_cast<uint8_t*>(host),
+                saved.data() + (addr - page),
+                n);
+        });
+    }
+}
+
+std::vector<types::Address> mem::MemoryImage::diff(const Snapshot& s) const {
+    std::vector<types::Address> pages;
+    for(const auto& [page, copy] : s.pages) {
+        if(*copyPage(page) != *copy) pages.push_back(page);
+    }
+    std::sort(pages.begin(), pages.end());
+    return pages;
 }
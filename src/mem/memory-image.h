@@ -3,16 +3,28 @@
 #ifndef ZIRCON_MEM_MEMORY_IMAGE_H_
 #define ZIRCON_MEM_MEMORY_IMAGE_H_
 
+#include "address-ranges.h"
+#include "flat-space.h"
+#include "page-table.h"
+#include "snapshot.h"
+
 #include "event/event.h"
 #include "hart/types.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstdint>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <memory>
+#include <optional>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -38,10 +50,14 @@ struct ReallocationMemoryException : public MemoryException {
         ss << MemoryException::what() << "\n";
         ss << "attempted to reallocate 0x" << std::hex << addr;
         if(size != 0) {
-            ss << " of size 0x" << std::hex << addr;
+            ss << " of size 0x" << std::hex << size;
         }
-        return strdup(ss.str().c_str());
+        message = ss.str();
+        return message.c_str();
     }
+
+  private:
+    mutable std::string message;
 };
 // struct OutOfMemoryException : public MemoryException {
 //     OutOfMemoryException(std::string message = "") :
@@ -67,8 +83,12 @@ struct OutOfBoundsException : public MemoryException {
                << std::hex << range_lower << "-0x" << std::hex << range_upper
                << "]";
         }
-        return strdup(ss.str().c_str());
+        message = ss.str();
+        return message.c_str();
     }
+
+  private:
+    mutable std::string message;
 };
 
 class MemoryImage {
@@ -78,15 +98,31 @@ class MemoryImage {
         types::Address address;
         types::UnsignedInteger size;
         uint8_t* buffer;
+        // bytes the region can grow to without moving, the buffer is zero
+        // past size
+        types::UnsignedInteger capacity;
+        // keeps the host buffer alive, the pieces left when part of a region
+        // is deallocated share it. empty for regions in the flat space
+        std::shared_ptr<uint8_t> storage;
+        // storage came from mapAnonymous instead of calloc
+        bool mapped;
         MemoryRegion(
             types::Address address,
             types::UnsignedInteger size,
-            uint8_t* buffer)
-            : address(address), size(size), buffer(buffer) {}
+            uint8_t* buffer,
+            types::UnsignedInteger capacity,
+            std::shared_ptr<uint8_t> storage,
+            bool mapped = false)
+            : address(address), size(size), buffer(buffer), capacity(capacity),
+              storage(std::move(storage)), mapped(mapped) {}
+
+        types::Address end() const { return address + size; }
+        bool contains(types::Address addr) const {
+            return addr >= address && addr < address + size;
+        }
 
         const uint8_t* raw(types::Address addr) const {
-            if(addr >= address && addr < address + size)
-                return buffer + (addr - address);
+            if(contains(addr)) return buffer + (addr - address);
             else throw OutOfBoundsException(addr, address, address + size);
         }
         uint8_t* raw(types::Address addr) {
@@ -106,7 +142,117 @@ class MemoryImage {
         }
     };
 
-    std::vector<MemoryRegion> memory_map;
+  public:
+    static constexpr types::Address CODE_PAGE_SIZE = 4096;
+    // regions at least this big are mapped from the host on demand, so the
+    // parts that are never touched cost nothing
+    static constexpr uint64_t LAZY_REGION_SIZE = 64 << 10;
+    // regions at least this big are backed by huge pages when they are
+    // enabled, see enableHugePages
+    static constexpr uint64_t HUGE_PAGE_SIZE = 2 << 20;
+    // what an access is for, each kind has its own TLB entries
+    enum class Access { FETCH, LOAD, STORE };
+
+  private:
+    // when set, region buffers are placed in the flat space instead of being
+    // allocated one by one
+    std::unique_ptr<FlatSpace> flat;
+    // set while a FaultGuard covers this image
+    bool guarded = false;
+    // set by the FaultGuard when a guarded access faulted. the host pages
+    // it faulted on are lent to it so that it can finish, it then sees this
+    // and calls raiseFault, which takes them back
+    std::atomic<bool> faulted = false;
+    std::array<types::Address, 2> lent_pages = {};
+    unsigned lent_count = 0;
+    friend class FaultGuard;
+    friend class FaultGuardSuspension;
+    // regions by start address, they never overlap. nodes of a map never
+    // move, so page_table can point at them
+    std::map<types::Address, MemoryRegion> memory_map;
+    uint64_t allocated_bytes = 0;
+    // each page points at a region that overlaps it. regions do not have to
+    // be page aligned, so a page can overlap several of them, those pages
+    // also list every region they overlap in shared_pages
+    PageTable<MemoryRegion> page_table;
+    std::unordered_map<types::Address, std::vector<MemoryRegion*>> shared_pages;
+
+    // direct mapped cache of pages that lie entirely inside one region, so
+    // most accesses skip the page table and the bounds checks. the tag of an
+    // empty entry is not page aligned, so it never matches
+    struct TLBEntry {
+        types::Address page = ~types::Address(0);
+        uint8_t* host = nullptr;
+    };
+    static constexpr size_t TLB_ENTRIES = 64;
+    std::array<std::array<TLBEntry, TLB_ENTRIES>, 3> tlb;
+
+    TLBEntry& tlbEntry(Access access, types::Address page) {
+        auto index = (page / PageTable<MemoryRegion>::PAGE_SIZE) % TLB_ENTRIES;
+        return tlb[size_t(access)][index];
+    }
+    uint8_t* translateSlow(Access access, types::Address addr, size_t n);
+    void flushTLB() { tlb = {}; }
+
+    // snapshots that may still want pages saved, oldest first. a page saved
+    // in one is also saved in every older one
+    std::vector<std::weak_ptr<Snapshot>> snapshots;
+    // set the dirty bit in page_table of every page that is written
+    bool dirty_tracking = false;
+    // writes have to be seen page by page, for snapshots or dirty tracking
+    bool tracking = false;
+    // record a write to [addr, addr+n) that is about to happen
+    void trackWrite(types::Address addr, uint64_t n);
+    // save the pages of [addr, addr+n) in the snapshots that are waiting for
+    // them, must be called before they are written
+    void savePages(types::Address addr, uint64_t n);
+    // pages only get store entries in the TLB once their writes have been
+    // tracked, so most writes are ruled out without looking any further
+    bool hasStoreEntry(types::Address addr, uint64_t n) {
+        auto page = PageTable<MemoryRegion>::pageOf(addr);
+        return page == PageTable<MemoryRegion>::pageOf(addr + n - 1) &&
+               tlbEntry(Access::STORE, page).page == page;
+    }
+    // calls f(addr, host, len) for each run of [addr, addr+n) that lies in one
+    // region, throws if part of it is not allocated
+    template <typename F>
+    void forEachRun(types::Address addr, uint64_t n, F&& f) {
+        while(n > 0) {
+            auto mr = getMemoryRegion(addr);
+            if(mr == nullptr) throw OutOfBoundsException(addr);
+            auto len = std::min(n, mr->end() - addr);
+            f(addr, mr->buffer + (addr - mr->address), len);
+            addr += len;
+            n -= len;
+        }
+    }
+    // calls f(addr, host, n) for each run of allocated bytes in the page
+    template <typename F> void forEachChunk(types::Address page, F&& f) const {
+        auto end = page + Snapshot::PAGE_SIZE;
+        for(auto addr = page; addr < end;) {
+            if(auto mr = getMemoryRegion(addr)) {
+                auto n = std::min(end, mr->end()) - addr;
+                f(addr, mr->raw(addr), n);
+                addr += n;
+            } else {
+                // skip ahead to the next region
+                auto next = memory_map.upper_bound(addr);
+                addr = next == memory_map.end() ? end
+                                                : std::min(end, next->first);
+            }
+        }
+    }
+    // flat memory is committed a host page at a time, so the unallocated
+    // bytes of a host page that is only partly allocated do not fault. set
+    // the PARTIAL bit of such pages at the edges of [addr, addr+size), which
+    // has just been allocated or deallocated, and clear it from the rest
+    void markPartialPages(types::Address addr, uint64_t size);
+    // take back the pages lent to guarded accesses that faulted
+    void returnLentPages();
+    // for a guarded access to addr that faulted
+    [[noreturn]] void raiseFault(types::Address addr);
+    // the page as it is now, with unallocated bytes reading as zero
+    std::shared_ptr<Snapshot::Page> copyPage(types::Address page) const;
 
     // Subsystem: mem
     // Description: Fires when memory is read
@@ -124,18 +270,197 @@ class MemoryImage {
     // Description: Fires when memory is allocated
     // Parameters: (base address, allocation size)
     event::Event<types::Address, uint64_t> event_allocation;
+    // Subsystem: mem
+    // Description: Fires once for each bulk read of memory
+    // Parameters: (base address, n bytes)
+    event::Event<types::Address, uint64_t> event_block_read;
+    // Subsystem: mem
+    // Description: Fires once for each bulk write of memory
+    // Parameters: (base address, n bytes)
+    event::Event<types::Address, uint64_t> event_block_write;
 
-    MemoryRegion& allocateMemoryRegion(types::Address addr, uint64_t size = 8) {
-        uint8_t* ptr = (uint8_t*)malloc(sizeof(*ptr) * size);
-        MemoryRegion mr(addr, size, ptr);
-        memory_map.push_back(mr);
-        return memory_map.back();
+    // read and write listeners that only want accesses to some addresses.
+    // the pages they cover have their WATCH_LOAD or WATCH_STORE bit set and
+    // never get TLB entries for that kind of access, so a TLB hit rules an
+    // access out. the hart keeps running blocks while only these are listening
+    template <typename Callback> struct WatchListener {
+        AddressRanges ranges;
+        Callback callback;
+    };
+    // marks the pages again whenever its listeners change
+    template <typename Callback>
+    class WatchList : public event::ListenerList<WatchListener<Callback>> {
+      private:
+        MemoryImage* mi;
+        Access access;
+        void changed() override { mi->rewatch(access); }
+
+      public:
+        WatchList(MemoryImage* mi, Access access) : mi(mi), access(access) {}
+    };
+    WatchList<decltype(event_read)::callback_type> watched_reads{
+        this,
+        Access::LOAD};
+    WatchList<decltype(event_write)::callback_type> watched_writes{
+        this,
+        Access::STORE};
+    static PageBit watchBit(Access access) {
+        return access == Access::STORE ? PageBit::WATCH_STORE
+                                       : PageBit::WATCH_LOAD;
+    }
+    void fireWatchedRead(types::Address addr, uint64_t value, size_t n) {
+        watched_reads.forEach([&](const auto& w) {
+            if(w.ranges.overlaps(addr, n)) w.callback(addr, value, n);
+        });
+    }
+    void fireWatchedWrite(
+        types::Address addr,
+        uint64_t value,
+        uint64_t old_value,
+        size_t n) {
+        watched_writes.forEach([&](const auto& w) {
+            if(w.ranges.overlaps(addr, n))
+                w.callback(addr, value, old_value, n);
+        });
+    }
+    // mark exactly the pages the enabled listeners for access cover
+    void rewatch(Access access) {
+        auto bit = watchBit(access);
+        page_table.clearBit(bit);
+        auto mark = [this, bit](const auto& w) {
+            for(auto [lower, upper] : w.ranges) {
+                page_table.setBit(bit, lower, upper - lower);
+            }
+        };
+        if(access == Access::LOAD) watched_reads.forEach(mark);
+        else watched_writes.forEach(mark);
+        tlb[size_t(access)] = {};
+    }
+
+    // Subsystem: mem
+    // Description: Fires when a page holding translated code is written, every
+    // translation made from that page is stale
+    // Parameters: (page address)
+    event::Event<types::Address> event_code_write;
+
+    // Subsystem: mem
+    // Description: Fires when memory is deallocated
+    // Parameters: (base address, deallocation size)
+    event::Event<types::Address, uint64_t> event_deallocation;
+
+    // pages that have been translated into blocks of instructions, a write to
+    // one bumps the code generation and fires event_code_write. the page then
+    // stops being tracked until it is translated again
+    std::unordered_set<types::Address> code_pages;
+    // lowest and highest translated address, so most writes are ruled out
+    // without looking at code_pages
+    types::Address code_lower = std::numeric_limits<types::Address>::max();
+    types::Address code_upper = 0;
+    uint64_t code_generation = 0;
+
+    static types::Address pageOf(types::Address addr) {
+        return addr & ~(CODE_PAGE_SIZE - 1);
+    }
+
+    // back large regions with transparent huge pages
+    bool huge_pages = false;
+
+    // zero filled host memory that is only backed once it is touched,
+    // nullptr if the host cannot map it. huge memory is aligned to
+    // HUGE_PAGE_SIZE and advised to use huge pages
+    static uint8_t* mapAnonymous(uint64_t size, bool huge = false);
+    static void unmapAnonymous(uint8_t* ptr, uint64_t size);
+    // zero [ptr, ptr+size) of mapped memory, handing whole pages back to the
+    // host
+    static void releaseAnonymous(uint8_t* ptr, uint64_t size);
+
+    // new regions always start out zeroed
+    MemoryRegion&
+    allocateMemoryRegion(types::Address addr, uint64_t size, uint64_t capacity) {
+        uint8_t* ptr = nullptr;
+        std::shared_ptr<uint8_t> storage;
+        bool mapped = false;
+        bool huge = huge_pages && capacity >= HUGE_PAGE_SIZE;
+        if(flat) {
+            ptr = flat->commit(addr, size);
+            // advising the whole capacity covers the growth to come
+            if(huge) flat->adviseHugePages(addr, capacity);
+            capacity = size;
+        } else if(
+            capacity >= LAZY_REGION_SIZE &&
+            (ptr = mapAnonymous(capacity, huge))) {
+            storage.reset(ptr, [capacity](uint8_t* p) {
+                unmapAnonymous(p, capacity);
+            });
+            mapped = true;
+        } else {
+            ptr = (uint8_t*)calloc(capacity, sizeof(*ptr));
+            storage.reset(ptr, free);
+        }
+        allocated_bytes += size;
+        auto& mr = memory_map
+                       .try_emplace(
+                           addr,
+                           addr,
+                           size,
+                           ptr,
+                           capacity,
+                           std::move(storage),
+                           mapped)
+                       .first->second;
+        mapPages(mr, mr.address, mr.size);
+        return mr;
+    }
+    // point the pages of [addr, addr+size) at mr as well
+    void mapPages(MemoryRegion& mr, types::Address addr, uint64_t size) {
+        page_table.forEachPage(addr, size, [this, &mr](auto page, auto& entry) {
+            if(entry == nullptr) {
+                entry = &mr;
+                return;
+            }
+            if(entry == &mr) return;
+            auto& regions = shared_pages[page];
+            if(regions.empty()) regions.push_back(entry);
+            if(std::find(regions.begin(), regions.end(), &mr) == regions.end())
+                regions.push_back(&mr);
+        });
+    }
+    // remove every page's reference to mr
+    void unmapPages(MemoryRegion& mr) {
+        page_table.forEachPage(
+            mr.address,
+            mr.size,
+            [this, &mr](auto page, auto& entry) {
+                auto it = shared_pages.find(page);
+                if(it == shared_pages.end()) {
+                    if(entry == &mr) entry = nullptr;
+                    return;
+                }
+                auto& regions = it->second;
+                regions.erase(
+                    std::remove(regions.begin(), regions.end(), &mr),
+                    regions.end());
+                entry = regions.empty() ? nullptr : regions.front();
+                if(regions.size() <= 1) shared_pages.erase(it);
+            });
+    }
+    // the region ending exactly at addr, if it can grow by size in place
+    MemoryRegion* growableRegion(types::Address addr, uint64_t size) {
+        auto it = memory_map.lower_bound(addr);
+        if(it == memory_map.begin()) return nullptr;
+        auto& mr = std::prev(it)->second;
+        if(mr.end() != addr) return nullptr;
+        if(flat || mr.capacity - mr.size >= size) return &mr;
+        return nullptr;
     }
 
     const MemoryRegion* getMemoryRegion(types::Address addr) const {
-        for(auto& mr : memory_map) {
-            if(addr >= mr.address && addr < mr.address + mr.size) {
-                return &mr;
+        auto mr = page_table.lookup(addr);
+        if(mr == nullptr || mr->contains(addr)) return mr;
+        if(auto it = shared_pages.find(page_table.pageOf(addr));
+           it != shared_pages.end()) {
+            for(auto other : it->second) {
+                if(other->contains(addr)) return other;
             }
         }
         return nullptr;
@@ -146,7 +471,7 @@ class MemoryImage {
     }
 
     template <typename T> struct MemoryCellProxy {
-      private:
+      protected:
         MemoryImage* mi;
         types::Address addr;
         friend MemoryImage;
@@ -157,40 +482,230 @@ class MemoryImage {
             else if(std::is_same<T, uint64_t>::value) return 8;
             return 8;
         }
-        MemoryRegion& mr() {
-            auto mr_ptr = mi->getMemoryRegion(addr);
-            if(mr_ptr) return *mr_ptr;
+        uint8_t* host(Access access) {
+            auto ptr = mi->translate(access, addr, sizeof(T));
+            if(ptr) return ptr;
             else throw OutOfBoundsException(addr);
         }
 
       public:
-        T read();
-        void write(T v);
+        T read() { return *reinterpret_cast<T*>(host(Access::LOAD)); }
+        void write(T v) { *reinterpret_cast<T*>(host(Access::STORE)) = v; }
         MemoryCellProxy(MemoryImage* mi, types::Address addr)
             : mi(mi), addr(addr) {}
         operator T() {
             T v = read();
-            mi->event_read(addr, v, getSize());
+            if(!mi->event_read.empty()) mi->event_read(addr, v, getSize());
+            if(mi->isWatched(Access::LOAD, addr, sizeof(T)))
+                mi->fireWatchedRead(addr, v, getSize());
             return v;
         }
         MemoryCellProxy<T>& operator=(T v) {
+            bool watched = mi->isWatched(Access::STORE, addr, sizeof(T));
+            // only read the old value if someone will see it
+            if(mi->event_write.empty() && !watched) {
+                write(v);
+                mi->markWritten(addr, getSize());
+                return *this;
+            }
             T old_value = read();
             write(v);
-            mi->event_write(addr, v, old_value, getSize());
+            mi->markWritten(addr, getSize());
+            if(!mi->event_write.empty())
+                mi->event_write(addr, v, old_value, getSize());
+            if(watched) mi->fireWatchedWrite(addr, v, old_value, getSize());
             return *this;
         }
     };
+    // the same cell without any events, used when nothing is listening
+    template <typename T> struct BareCellProxy : private MemoryCellProxy<T> {
+        BareCellProxy(MemoryImage* mi, types::Address addr)
+            : MemoryCellProxy<T>(mi, addr) {}
+        operator T() {
+            // watched pages take the long way, which fires the listeners
+            if(this->mi->isWatched(Access::LOAD, this->addr, sizeof(T)))
+                return MemoryCellProxy<T>::operator T();
+            T value = *reinterpret_cast<T*>(bareHost(Access::LOAD));
+            checkFault();
+            return value;
+        }
+        BareCellProxy<T>& operator=(T v) {
+            if(this->mi->isWatched(Access::STORE, this->addr, sizeof(T))) {
+                MemoryCellProxy<T>::operator=(v);
+                return *this;
+            }
+            *reinterpret_cast<T*>(bareHost(Access::STORE)) = v;
+            checkFault();
+            this->mi->markWritten(this->addr, this->getSize());
+            return *this;
+        }
+
+      private:
+        uint8_t* bareHost(Access access) {
+            // a FaultGuard catches accesses to memory that is not allocated,
+            // so there is no need to check first. stores still have to go
+            // through translate while writes are tracked, and watched
+            // accesses so that the TLB can rule them out. partly allocated
+            // host pages do not fault, so they are checked as well
+            if(this->mi->guarded &&
+               (access != Access::STORE || !this->mi->tracking) &&
+               !this->mi->watching(access) &&
+               FlatSpace::contains(this->addr, sizeof(T)) &&
+               !this->mi->page_table
+                    .testBit(PageBit::PARTIAL, this->addr, sizeof(T)))
+                return this->mi->flat->host(this->addr);
+            return this->host(access);
+        }
+        // the access through bareHost that just ran may have faulted
+        void checkFault() {
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            if(this->mi->faulted.load(std::memory_order_relaxed))
+                this->mi->raiseFault(this->addr);
+        }
+    };
 
   public:
+    // memory as instruction bodies see it when nothing is listening, accesses
+    // through it do not fire events
+    class BareView {
+      private:
+        MemoryImage* mi;
+
+      public:
+        BareView(MemoryImage& mi) : mi(&mi) {}
+        BareCellProxy<uint8_t> byte(types::Address addr) {
+            return BareCellProxy<uint8_t>(mi, addr);
+        }
+        BareCellProxy<uint16_t> halfword(types::Address addr) {
+            return BareCellProxy<uint16_t>(mi, addr);
+        }
+        BareCellProxy<uint32_t> word(types::Address addr) {
+            return BareCellProxy<uint32_t>(mi, addr);
+        }
+        BareCellProxy<uint64_t> doubleword(types::Address addr) {
+            return BareCellProxy<uint64_t>(mi, addr);
+        }
+        void invalidateCode() { mi->invalidateCode(); }
+    };
+
     MemoryImage() = default;
+    // listeners hold on to the image
+    MemoryImage(const MemoryImage&) = delete;
+    MemoryImage& operator=(const MemoryImage&) = delete;
 
-    void allocate(types::Address addr, uint64_t size) {
+    // place all guest memory in one reserved host range, see FlatSpace. must
+    // be called before anything is allocated, returns false if the host
+    // cannot reserve the range
+    bool enableFlatBackend() {
+        if(!memory_map.empty()) return false;
+        flat = FlatSpace::reserve();
+        return flat != nullptr;
+    }
+    // the host address of addr when the flat backend is in use, without
+    // checking that addr is allocated. nullptr if addr is not in the flat
+    // space
+    uint8_t* flatHost(types::Address addr) const {
+        if(flat && FlatSpace::contains(addr)) return flat->host(addr);
+        return nullptr;
+    }
+    bool hasFlatBackend() const { return flat != nullptr; }
+    // back regions of at least HUGE_PAGE_SIZE with transparent huge pages,
+    // which cuts host TLB misses when the guest walks large arrays. only
+    // regions allocated afterwards are affected, returns false if the host
+    // does not support them
+    bool enableHugePages();
+    // total size of every region, whether or not it has been touched
+    uint64_t getAllocatedBytes() const { return allocated_bytes; }
+
+    // allocate zeroed memory at [addr, addr+size). memory allocated right
+    // after a region that has room to spare extends it, reserve asks for
+    // that much room in a new region so later allocations can do the same
+    void allocate(types::Address addr, uint64_t size, uint64_t reserve = 0) {
         if(size == 0) return;
         event_allocation(addr, size);
-        if(getMemoryRegion(addr)) {
+        if(!isFree(addr, size)) {
             throw ReallocationMemoryException(addr, size);
         }
-        allocateMemoryRegion(addr, size);
+        if(auto mr = growableRegion(addr, size)) {
+            if(flat) flat->commit(addr, size);
+            mr->size += size;
+            allocated_bytes += size;
+            mapPages(*mr, addr, size);
+        } else allocateMemoryRegion(addr, size, std::max(size, reserve));
+        if(flat) markPartialPages(addr, size);
+        flushTLB();
+    }
+    // free [addr, addr+size), regions that only partly overlap it keep the
+    // rest. any host pointer into the range is invalid afterwards
+    void deallocate(types::Address addr, uint64_t size);
+    // true if no part of [addr, addr+size) is allocated
+    bool isFree(types::Address addr, uint64_t size) const {
+        if(addr + size < addr) return false;
+        auto it = memory_map.lower_bound(addr);
+        if(it != memory_map.end() && it->second.address < addr + size)
+            return false;
+        return it == memory_map.begin() || std::prev(it)->second.end() <= addr;
+    }
+    // true if the backend can place memory at [addr, addr+size) once it is
+    // free. the flat backend only has its windows
+    bool canAllocate(types::Address addr, uint64_t size) const {
+        if(addr + size < addr) return false;
+        return !flat || FlatSpace::contains(addr, size);
+    }
+    // true if every byte of [addr, addr+size) is allocated
+    bool isAllocated(types::Address addr, uint64_t size) const {
+        while(size > 0) {
+            auto mr = getMemoryRegion(addr);
+            if(mr == nullptr) return false;
+            auto len = std::min(size, mr->end() - addr);
+            addr += len;
+            size -= len;
+        }
+        return true;
+    }
+    // the highest page aligned address in [lower, upper) where size bytes
+    // are free, for placing mappings
+    std::optional<types::Address>
+    findFree(uint64_t size, types::Address lower, types::Address upper) const;
+
+    // bulk accesses, they work a region at a time and fire one block event
+    // instead of an event per byte. an OutOfBoundsException is thrown at the
+    // first byte that is not allocated, after the bytes before it are done
+    void readBlock(types::Address addr, void* dst, uint64_t n);
+    void writeBlock(types::Address addr, const void* src, uint64_t n);
+    void fill(types::Address addr, uint8_t value, uint64_t n);
+    // the ranges may overlap
+    void copy(types::Address dst, types::Address src, uint64_t n);
+
+    // capture the memory as it is now. pages are copied lazily the first
+    // time they are written, so taking a snapshot is cheap and keeping one
+    // costs a page for every page written since. the hart must not be
+    // running blocks while a snapshot is taken
+    std::shared_ptr<Snapshot> snapshot();
+    // put back the allocations and contents that s captured
+    void restore(const Snapshot& s);
+    // the pages whose contents differ from s, in address order. bytes that
+    // are not allocated read as zero
+    std::vector<types::Address> diff(const Snapshot& s) const;
+
+    // while enabled, every page that is written or deallocated is marked
+    // dirty. pages written before it is enabled are not
+    void setDirtyTracking(bool enabled) {
+        dirty_tracking = enabled;
+        tracking = dirty_tracking || !snapshots.empty();
+        tlb[size_t(Access::STORE)] = {};
+    }
+    // the dirty pages, in address order
+    std::vector<types::Address> getDirtyPages() const {
+        std::vector<types::Address> pages;
+        page_table.forEachSet(PageBit::DIRTY, [&pages](auto page) {
+            pages.push_back(page);
+        });
+        return pages;
+    }
+    void clearDirtyPages() {
+        page_table.clearBit(PageBit::DIRTY);
+        tlb[size_t(Access::STORE)] = {};
     }
 
     MemoryCellProxy<uint8_t> byte(types::Address addr) {
@@ -214,14 +729,186 @@ class MemoryImage {
     uint8_t* raw(types::Address addr) {
         return const_cast<uint8_t*>(std::as_const(*this).raw(addr));
     }
-    template <typename T> void addReadListener(T&& arg) {
-        event_read.addListener(std::forward<T>(arg));
+    // the host address of [addr, addr+n), nullptr unless all of it is
+    // allocated and in one piece on the host. does not fire events
+    uint8_t* raw(types::Address addr, uint64_t n) {
+        auto host = raw(addr);
+        if(host == nullptr || addr + n < addr) return nullptr;
+        for(auto at = addr; at - addr < n;) {
+            auto mr = getMemoryRegion(at);
+            if(mr == nullptr || mr->raw(at) != host + (at - addr))
+                return nullptr;
+            at = mr->end();
+        }
+        return host;
+    }
+    // the host address for an n byte access at addr, nullptr if addr is not
+    // allocated. does not fire events
+    uint8_t* translate(Access access, types::Address addr, size_t n) {
+        auto page = PageTable<MemoryRegion>::pageOf(addr);
+        auto& entry = tlbEntry(access, page);
+        if(entry.page == page &&
+           addr + n <= page + PageTable<MemoryRegion>::PAGE_SIZE)
+            return entry.host + (addr - page);
+        return translateSlow(access, addr, n);
+    }
+    // the instruction word at addr, through the fetch entries of the TLB
+    const types::InstructionWord* fetch(types::Address addr) {
+        return reinterpret_cast<const types::InstructionWord*>(translate(
+            Access::FETCH,
+            addr,
+            sizeof(types::InstructionWord)));
+    }
+    // record that [lower, upper) holds translated code
+    void addCodeRange(types::Address lower, types::Address upper) {
+        code_lower = std::min(code_lower, lower);
+        code_upper = std::max(code_upper, upper);
+        for(auto page = pageOf(lower); page < upper; page += CODE_PAGE_SIZE) {
+            code_pages.insert(page);
+        }
+    }
+    uint64_t getCodeGeneration() const { return code_generation; }
+    // true if any page of [addr, addr+n) holds translated code
+    bool isCode(types::Address addr, uint64_t n) const {
+        if(n == 0 || addr >= code_upper || addr + n <= code_lower) return false;
+        auto first = pageOf(std::max(addr, code_lower));
+        auto last = pageOf(std::min(addr + n, code_upper) - 1);
+        if((last - first) / CODE_PAGE_SIZE < code_pages.size()) {
+            for(auto page = first; page <= last; page += CODE_PAGE_SIZE) {
+                if(code_pages.count(page)) return true;
+            }
+            return false;
+        }
+        return std::any_of(
+            code_pages.begin(),
+            code_pages.end(),
+            [first, last](auto page) { return page >= first && page <= last; });
+    }
+    // must be called by anything writing through a raw pointer, writes made
+    // with byte/halfword/word/doubleword are already tracked
+    void markWritten(types::Address addr, uint64_t n) {
+        if(tracking && n != 0 && !hasStoreEntry(addr, n)) trackWrite(addr, n);
+        if(n == 0 || addr >= code_upper || addr + n <= code_lower) return;
+        auto last = pageOf(std::min(addr + n, code_upper) - 1);
+        for(auto page = pageOf(std::max(addr, code_lower)); page <= last;
+            page += CODE_PAGE_SIZE) {
+            if(code_pages.erase(page)) {
+                code_generation++;
+                event_code_write(page);
+            }
+        }
+    }
+    // treat every translated page as written, for fence.i
+    void invalidateCode() {
+        std::vector<types::Address> pages(code_pages.begin(), code_pages.end());
+        code_pages.clear();
+        code_generation++;
+        for(auto page : pages) {
+            event_code_write(page);
+        }
+    }
+
+    // the host buffer backing the region that holds addr, for callers that
+    // want to access memory directly. accesses made this way skip events and
+    // writes must be reported with markWritten
+    struct HostRange {
+        types::Address base;
+        uint64_t size;
+        uint8_t* host;
+    };
+    std::optional<HostRange> getHostRange(types::Address addr) {
+        auto mr = getMemoryRegion(addr);
+        if(mr) return HostRange{mr->address, mr->size, mr->buffer};
+        else return std::nullopt;
+    }
+    // the part of getHostRange that may be stored to directly. while writes
+    // are tracked or watched that is only the page holding addr, writes to
+    // the other pages have to be seen first
+    std::optional<HostRange> getStoreRange(types::Address addr) {
+        auto range = getHostRange(addr);
+        if(!range || (!tracking && !watching(Access::STORE))) return range;
+        return getPageRange(Access::STORE, *range, addr);
+    }
+    // the part of getHostRange that may be loaded from directly, which is
+    // only the page holding addr while loads are watched
+    std::optional<HostRange> getLoadRange(types::Address addr) {
+        auto range = getHostRange(addr);
+        if(!range || !watching(Access::LOAD)) return range;
+        return getPageRange(Access::LOAD, *range, addr);
+    }
+    // true if any watch listener wants this kind of access
+    bool watching(Access access) const {
+        if(access == Access::LOAD) return !watched_reads.empty();
+        if(access == Access::STORE) return !watched_writes.empty();
+        return false;
+    }
+    // true if [addr, addr+n) touches a page that a watch listener covers
+    bool isWatched(Access access, types::Address addr, size_t n) {
+        if(!watching(access)) return false;
+        auto page = PageTable<MemoryRegion>::pageOf(addr);
+        if(page == PageTable<MemoryRegion>::pageOf(addr + n - 1) &&
+           tlbEntry(access, page).page == page)
+            return false;
+        return page_table.testBit(watchBit(access), addr, n);
+    }
+
+  private:
+    // the page of range holding addr, nothing if accesses to it are watched
+    std::optional<HostRange>
+    getPageRange(Access access, const HostRange& range, types::Address addr) {
+        if(page_table.testBit(watchBit(access), addr, 1)) return std::nullopt;
+        auto page = PageTable<MemoryRegion>::pageOf(addr);
+        auto lower = std::max(range.base, page);
+        auto upper = std::min(
+            range.base + range.size,
+            page + PageTable<MemoryRegion>::PAGE_SIZE);
+        return HostRange{
+            lower,
+            upper - lower,
+            range.host + (lower - range.base)};
+    }
+
+  public:
+    // listeners that fire for single accesses. allocations come from the
+    // host, which fires them the same way however instructions run
+    bool hasListeners() const {
+        return !event_read.empty() || !event_write.empty();
+    }
+    template <typename T> event::ListenerHandle addReadListener(T&& arg) {
+        return event_read.addListener(std::forward<T>(arg));
+    }
+    template <typename T> event::ListenerHandle addWriteListener(T&& arg) {
+        return event_write.addListener(std::forward<T>(arg));
+    }
+    // listeners that only fire for accesses touching ranges. they cost next
+    // to nothing elsewhere, and do not stop the hart from running blocks
+    template <typename T>
+    event::ListenerHandle addReadListener(AddressRanges ranges, T&& arg) {
+        return watched_reads.add({std::move(ranges), std::forward<T>(arg)});
+    }
+    template <typename T>
+    event::ListenerHandle addWriteListener(AddressRanges ranges, T&& arg) {
+        return watched_writes.add({std::move(ranges), std::forward<T>(arg)});
+    }
+    template <typename T>
+    event::ListenerHandle addAllocationListener(T&& arg) {
+        return event_allocation.addListener(std::forward<T>(arg));
+    }
+    template <typename T>
+    event::ListenerHandle addBlockReadListener(T&& arg) {
+        return event_block_read.addListener(std::forward<T>(arg));
+    }
+    template <typename T>
+    event::ListenerHandle addBlockWriteListener(T&& arg) {
+        return event_block_write.addListener(std::forward<T>(arg));
     }
-    template <typename T> void addWriteListener(T&& arg) {
-        event_write.addListener(std::forward<T>(arg));
+    template <typename T>
+    event::ListenerHandle addCodeWriteListener(T&& arg) {
+        return event_code_write.addListener(std::forward<T>(arg));
     }
-    template <typename T> void addAllocationListener(T&& arg) {
-        event_allocation.addListener(std::forward<T>(arg));
+    template <typename T>
+    event::ListenerHandle addDeallocationListener(T&& arg) {
+        return event_deallocation.addListener(std::forward<T>(arg));
     }
 };
 
@@ -0,0 +1,180 @@
+#ifndef ZIRCON_MEM_PAGE_TABLE_H_
+#define ZIRCON_MEM_PAGE_TABLE_H_
+
+#include "hart/types.h"
+
+#include <array>
+#include <cstddef>
+#include <memory>
+
+namespace mem {
+
+// bits kept for every page, see PageTable::setBit
+enum class PageBit : unsigned {
+    DIRTY,
+    WATCH_LOAD,
+    WATCH_STORE,
+    // part of the host page is allocated, see MemoryImage::markPartialPages
+    PARTIAL,
+    COUNT
+};
+
+namespace internal {
+// one level of the radix tree, level 0 holds the entries themselves
+template <typename T, unsigned Level, size_t Entries> struct PageTableNode {
+    std::array<std::unique_ptr<PageTableNode<T, Level - 1, Entries>>, Entries>
+        next{};
+};
+template <typename T, size_t Entries> struct PageTableNode<T, 0, Entries> {
+    std::array<T*, Entries> entries{};
+    // one bitmap per PageBit, with a bit per entry
+    std::array<std::array<uint64_t, Entries / 64>, size_t(PageBit::COUNT)>
+        bits{};
+};
+} // namespace internal
+
+// maps guest pages to a T*, as a radix tree over the page number. nodes are
+// only allocated for the parts of the address space that are mapped, so a
+// lookup costs the same no matter how many pages are mapped
+template <typename T> class PageTable {
+  public:
+    static constexpr unsigned PAGE_BITS = 12;
+    static constexpr types::Address PAGE_SIZE = types::Address(1) << PAGE_BITS;
+
+  private:
+    // 4 levels of 13 bits cover the 52 bit page number
+    static constexpr unsigned LEVEL_BITS = 13;
+    static constexpr unsigned LEVELS = 4;
+    static constexpr size_t ENTRIES = size_t(1) << LEVEL_BITS;
+    static_assert(PAGE_BITS + LEVEL_BITS * LEVELS == 64);
+
+    template <unsigned Level>
+    using Node = internal::PageTableNode<T, Level, ENTRIES>;
+    std::unique_ptr<Node<LEVELS - 1>> root;
+
+    static size_t index(types::Address addr, unsigned level) {
+        return (addr >> (PAGE_BITS + level * LEVEL_BITS)) & (ENTRIES - 1);
+    }
+    Node<0>& leaf(types::Address addr) {
+        auto& l2 = root->next[index(addr, 3)];
+        if(!l2) l2 = std::make_unique<Node<2>>();
+        auto& l1 = l2->next[index(addr, 2)];
+        if(!l1) l1 = std::make_unique<Node<1>>();
+        auto& l0 = l1->next[index(addr, 1)];
+        if(!l0) l0 = std::make_unique<Node<0>>();
+        return *l0;
+    }
+    T*& entry(types::Address addr) {
+        return leaf(addr).entries[index(addr, 0)];
+    }
+    // calls f(base, leaf) for every leaf in address order, base being the
+    // address of the leaf's first page
+    template <typename F> void forEachLeaf(F&& f) const {
+        for(size_t i3 = 0; i3 < ENTRIES; i3++) {
+            auto l2 = root->next[i3].get();
+            if(!l2) continue;
+            for(size_t i2 = 0; i2 < ENTRIES; i2++) {
+                auto l1 = l2->next[i2].get();
+                if(!l1) continue;
+                for(size_t i1 = 0; i1 < ENTRIES; i1++) {
+                    auto l0 = l1->next[i1].get();
+                    if(!l0) continue;
+                    auto base = ((((types::Address(i3) << LEVEL_BITS) | i2)
+                                  << LEVEL_BITS) |
+                                 i1)
+                                << (LEVEL_BITS + PAGE_BITS);
+                    f(base, *l0);
+                }
+            }
+        }
+    }
+
+  public:
+    PageTable() : root(std::make_unique<Node<LEVELS - 1>>()) {}
+
+    static types::Address pageOf(types::Address addr) {
+        return addr & ~(PAGE_SIZE - 1);
+    }
+
+    // the entry for the page holding addr, nullptr if it is not mapped
+    T* lookup(types::Address addr) const {
+        auto l2 = root->next[index(addr, 3)].get();
+        if(!l2) return nullptr;
+        auto l1 = l2->next[index(addr, 2)].get();
+        if(!l1) return nullptr;
+        auto l0 = l1->next[index(addr, 1)].get();
+        if(!l0) return nullptr;
+        return l0->entries[index(addr, 0)];
+    }
+
+    // set bit b of every page touched by [addr, addr+size)
+    void setBit(PageBit b, types::Address addr, uint64_t size) {
+        if(size == 0) return;
+        auto last = pageOf(addr + size - 1);
+        for(auto page = pageOf(addr);; page += PAGE_SIZE) {
+            auto i = index(page, 0);
+            leaf(page).bits[size_t(b)][i / 64] |= uint64_t(1) << (i % 64);
+            if(page == last) break;
+        }
+    }
+    // true if bit b is set for any page touched by [addr, addr+size)
+    bool testBit(PageBit b, types::Address addr, uint64_t size) const {
+        if(size == 0) return false;
+        auto last = pageOf(addr + size - 1);
+        for(auto page = pageOf(addr);; page += PAGE_SIZE) {
+            auto l2 = root->next[index(page, 3)].get();
+            auto l1 = l2 ? l2->next[index(page, 2)].get() : nullptr;
+            auto l0 = l1 ? l1->next[index(page, 1)].get() : nullptr;
+            auto i = index(page, 0);
+            if(l0 && (l0->bits[size_t(b)][i / 64] >> (i % 64)) & 1)
+                return true;
+            if(page == last) return false;
+        }
+    }
+    // calls f(page) for every page with bit b set, in address order
+    template <typename F> void forEachSet(PageBit b, F&& f) const {
+        forEachLeaf([b, &f](types::Address base, const Node<0>& l0) {
+            const auto& bits = l0.bits[size_t(b)];
+            for(size_t w = 0; w < bits.size(); w++) {
+                for(auto word = bits[w]; word != 0; word &= word - 1) {
+                    auto i = w * 64 + size_t(__builtin_ctzll(word));
+                    f(base + (types::Address(i) << PAGE_BITS));
+                }
+            }
+        });
+    }
+    void clearBit(PageBit b) {
+        forEachLeaf(
+            [b](types::Address, Node<0>& l0) { l0.bits[size_t(b)] = {}; });
+    }
+    // clear bit b of every page touched by [addr, addr+size)
+    void clearBit(PageBit b, types::Address addr, uint64_t size) {
+        if(size == 0) return;
+        auto last = pageOf(addr + size - 1);
+        for(auto page = pageOf(addr);; page += PAGE_SIZE) {
+            // pages without a leaf have no bits to clear
+            auto l2 = root->next[index(page, 3)].get();
+            auto l1 = l2 ? l2->next[index(page, 2)].get() : nullptr;
+            auto l0 = l1 ? l1->next[index(page, 1)].get() : nullptr;
+            auto i = index(page, 0);
+            if(l0) l0->bits[size_t(b)][i / 64] &= ~(uint64_t(1) << (i % 64));
+            if(page == last) break;
+        }
+    }
+
+    // calls f(page, entry) for every page touched by [addr, addr+size), where
+    // entry is a reference to the page's slot in the table
+    template <typename F>
+    void forEachPage(types::Address addr, uint64_t size, F&& f) {
+        if(size == 0) return;
+        auto last = pageOf(addr + size - 1);
+        for(auto page = pageOf(addr);; page += PAGE_SIZE) {
+            f(page, entry(page));
+            if(page == last) break;
+        }
+    }
+};
+
+} // namespace mem
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef ZIRCON_MEM_SNAPSHOT_H_
+#define ZIRCON_MEM_SNAPSHOT_H_
+
+#include "page-table.h"
+
+#include "hart/types.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mem {
+
+// the contents of a MemoryImage at one point in time, see
+// MemoryImage::snapshot. nothing is copied when it is taken, instead a page
+// is saved here the first time it is written afterwards. the saved copy is
+// shared with every other snapshot that is still waiting for that page
+class Snapshot {
+  public:
+    static constexpr types::Address PAGE_SIZE = PageTable<void>::PAGE_SIZE;
+    // a page as it was, bytes that were not allocated are zero
+    using Page = std::array<uint8_t, PAGE_SIZE>;
+
+  private:
+    friend class MemoryImage;
+    // the allocated ranges as (address, size), in address order
+    std::vector<std::pair<types::Address, uint64_t>> layout;
+    // pages written since the snapshot was taken, as they were
+    std::unordered_map<types::Address, std::shared_ptr<const Page>> pages;
+
+  public:
+    // number of pages that have been saved so far
+    size_t getSavedPages() const { return pages.size(); }
+};
+
+} // namespace mem
+
+#endif
@@ -0,0 +1,148 @@
+#include "microbench.h"
+
+#include "common/argparse.hpp"
+#include "hart/hart.h"
+#include "hart/hartstate.h"
+#include "mem/memory-image.h"
+
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace microbench {
+
+namespace {
+constexpr types::Address CODE = 0x10000;
+constexpr types::Address PATCHED = 0x11000;
+
+// patches the instruction it calls on every iteration, s3 holds the number
+// of iterations. the store leaves its block early each time
+//    lui s1, 0x11         # patched
+//    lui s2, 0x50
+//    addi s2, s2, 0x513   # addi a0, a0, 0
+// 1:
+//    slli t0, s3, 20
+//    or t0, t0, s2
+//    sw t0, 0(s1)
+//    mv a0, s0
+//    jalr ra, 0(s1)
+//    mv s0, a0
+//    addi s3, s3, -1
+//    bnez s3, 1b
+//    li a0, 0
+//    li a7, 93            # exit
+//    ecall
+const uint32_t PROGRAM[] = {
+    0x000114b7, 0x00050937, 0x51390913, 0x01499293, 0x0122e2b3, 0x0054a023,
+    0x00040513, 0x000480e7, 0x00050413, 0xfff98993, 0xfe0992e3, 0x00000513,
+    0x05d00893, 0x00000073,
+};
+// patched:
+//    addi a0, a0, 0
+//    ret
+const uint32_t PATCHED_PROGRAM[] = {0x00050513, 0x00008067};
+
+enum class Mode { LISTENER, BLOCKS, HOOKED, JIT, JIT_VERIFY };
+struct Run {
+    std::vector<uint64_t> counts;
+    double time;
+};
+
+// runs the program with instruction counts enabled, unless counting is off
+Run run(Mode mode, bool flat, bool counting, uint64_t iterations) {
+    auto m = std::make_shared<mem::MemoryImage>();
+    if(flat) m->enableFlatBackend();
+    m->allocate(CODE, PATCHED + sizeof(PATCHED_PROGRAM) - CODE);
+    m->writeBlock(CODE, PROGRAM, sizeof(PROGRAM));
+    m->writeBlock(PATCHED, PATCHED_PROGRAM, sizeof(PATCHED_PROGRAM));
+
+    hart::Hart hart(m);
+    if(mode == Mode::JIT || mode == Mode::JIT_VERIFY) {
+        if(!hart.enableJit(mode == Mode::JIT_VERIFY))
+            std::cerr << "The JIT is not supported\n";
+    }
+    if(counting) hart.enableInstructionCounts();
+    // a listener for every instruction makes the hart step, one for stores
+    // only steps the blocks that hold the store
+    event::ListenerHandle listener;
+    if(mode == Mode::LISTENER)
+        listener = hart.addBeforeExecuteListener([](hart::HartState&) {});
+    else if(mode == Mode::HOOKED) {
+        listener = hart.addBeforeExecuteListener(
+            isa::inst::OpcodeSet::stores(),
+            [](hart::HartState&) {});
+    }
+    hart.init();
+    auto& hs = hart.hs();
+    hs.rf().GPR[19] = iterations;
+    hs.setPC(CODE);
+    hs.start();
+    auto t = time([&]() {
+        hart.startExecution();
+        hart.wait_till_done();
+    });
+    return {hart.getInstructionCounts(), t};
+}
+} // namespace
+
+int counts(int argc, const char** argv) {
+    argparse::ArgumentParser args("counts");
+    args.add_argument("-n", "--iterations")
+        .default_value(size_t(1) << 20)
+        .action([](const std::string& value) { return size_t(std::stoull(value)); })
+        .help("number of times the program patches itself when timed");
+    args.add_argument("-f", "--flat")
+        .default_value(false)
+        .implicit_value(true)
+        .help("use the flat memory backend");
+    try {
+        args.parse_args(argc, argv);
+    } catch(const std::runtime_error& err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << args;
+        return 1;
+    }
+    auto iterations = args.get<size_t>("--iterations");
+    auto flat = args.get<bool>("--flat");
+    if(flat && !mem::MemoryImage().enableFlatBackend()) {
+        std::cerr << "Flat memory is not supported on this host" << std::endl;
+        return 1;
+    }
+
+    // the counts --stats prints have to be the same however the program
+    // runs. stepping with a listener counts one instruction at a time, so it
+    // is the reference
+    const char* names[] = {"listener", "blocks", "hooked", "jit", "jit-verify"};
+    Mode modes[] = {
+        Mode::LISTENER,
+        Mode::BLOCKS,
+        Mode::HOOKED,
+        Mode::JIT,
+        Mode::JIT_VERIFY};
+    auto expected = run(Mode::LISTENER, flat, true, 100).counts;
+    int failures = 0;
+    for(size_t i = 1; i < std::size(modes); i++) {
+        auto got = run(modes[i], flat, true, 100).counts;
+        if(got == expected) continue;
+        std::cerr << names[i] << ": instruction counts differ from stepping"
+                  << std::endl;
+        failures++;
+    }
+    if(failures != 0) return 1;
+
+    std::cout << "running " << iterations
+              << " iterations of a self-modifying loop\n";
+    std::cout << std::fixed << std::setprecision(2);
+    for(size_t i = 1; i < std::size(modes); i++) {
+        if(modes[i] == Mode::JIT_VERIFY) continue;
+        auto plain = run(modes[i], flat, false, iterations).time;
+        auto counted = run(modes[i], flat, true, iterations).time;
+        std::cout << std::setw(10) << names[i] << ": " << std::setw(8)
+                  << (plain * 1e3) << " ms, " << std::setw(8)
+                  << (counted * 1e3) << " ms counted\n";
+    }
+    return 0;
+}
+
+} // namespace microbench
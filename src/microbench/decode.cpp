@@ -0,0 +1,165 @@
+#include "microbench.h"
+
+#include "common/argparse.hpp"
+#include "elf/elf.h"
+#include "hart/isa/inst.h"
+#include "hart/isa/instruction_match.h"
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+namespace isa {
+namespace inst {
+namespace internal {
+extern uint64_t getOpcodePrecedence(Opcode op);
+#define CUSTOM(prefix, name, opcode, matcher, printer, execution, precedence)  \
+    extern bool prefix##_##name##_matcher_func(uint32_t bits);
+#include "hart/isa/defs/instructions.inc"
+
+namespace {
+// the decoder zircon used before the table, tries every instruction in order
+Opcode decodeInstructionLinear(uint32_t bits) {
+    Opcode matched = Opcode::UNKNOWN;
+#define R_TYPE(prefix, name, opcode, funct7, funct3, execution, precedence)    \
+    if(instruction::getOpcode(bits) == opcode &&                               \
+       instruction::getFunct7(bits) == funct7 &&                               \
+       instruction::getFunct3(bits) == funct3 &&                               \
+       (matched == Opcode::UNKNOWN ||                                          \
+        precedence < getOpcodePrecedence(matched))) {                          \
+        matched = Opcode::prefix##_##name;                                     \
+    }
+#define I_TYPE(prefix, name, opcode, funct3, execution, precedence)            \
+    if(instruction::getOpcode(bits) == opcode &&                               \
+       instruction::getFunct3(bits) == funct3 &&                               \
+       (matched == Opcode::UNKNOWN ||                                          \
+        precedence < getOpcodePrecedence(matched))) {                          \
+        matched = Opcode::prefix##_##name;                                     \
+    }
+#define S_TYPE(prefix, name, opcode, funct3, execution, precedence)            \
+    if(instruction::getOpcode(bits) == opcode &&                               \
+       instruction::getFunct3(bits) == funct3 &&                               \
+       (matched == Opcode::UNKNOWN ||                                          \
+        precedence < getOpcodePrecedence(matched))) {                          \
+        matched = Opcode::prefix##_##name;                                     \
+    }
+#define B_TYPE(prefix, name, opcode, funct3, execution, precedence)            \
+    if(instruction::getOpcode(bits) == opcode &&                               \
+       instruction::getFunct3(bits) == funct3 &&                               \
+       (matched == Opcode::UNKNOWN ||                                          \
+        precedence < getOpcodePrecedence(matched))) {                          \
+        matched = Opcode::prefix##_##name;                                     \
+    }
+#define U_TYPE(prefix, name, opcode, execution, precedence)                    \
+    if(instruction::getOpcode(bits) == opcode &&                               \
+       (matched == Opcode::UNKNOWN ||                                          \
+        precedence < getOpcodePrecedence(matched))) {                          \
+        matched = Opcode::prefix##_##name;                                     \
+    }
+#define J_TYPE(prefix, name, opcode, execution, precedence)                    \
+    if(instruction::getOpcode(bits) == opcode &&                               \
+       (matched == Opcode::UNKNOWN ||                                          \
+        precedence < getOpcodePrecedence(matched))) {                          \
+        matched = Opcode::prefix##_##name;                                     \
+    }
+#define CUSTOM(prefix, name, opcode, matcher, printer, execution, precedence)  \
+    if(prefix##_##name##_matcher_func(bits)) matched = Opcode::prefix##_##name;
+#include "hart/isa/defs/instructions.inc"
+
+    return matched;
+}
+} // namespace
+} // namespace internal
+} // namespace inst
+} // namespace isa
+
+namespace microbench {
+
+int decode(int argc, const char** argv) {
+    argparse::ArgumentParser args("decode");
+    args.add_argument("file").help("elf64 file to read instructions from");
+    args.add_argument("-s", "--section")
+        .default_value(std::string(".text"))
+        .help("section to decode");
+    args.add_argument("-n", "--iterations")
+        .default_value(size_t(100))
+        .action([](const std::string& value) { return size_t(std::stoull(value)); })
+        .help("number of times to decode the section");
+    try {
+        args.parse_args(argc, argv);
+    } catch(const std::runtime_error& err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << args;
+        return 1;
+    }
+
+    auto filename = args.get<std::string>("file");
+    auto section = args.get<std::string>("--section");
+    auto iterations = args.get<size_t>("--iterations");
+
+    elf::File elf(filename);
+    if(!elf.isValid()) {
+        std::cerr << "Invalid ELF file '" << filename << "'" << std::endl;
+        return 1;
+    }
+    auto contents = elf.getSectionContents(section);
+    std::vector<uint32_t> words(contents.size() / sizeof(uint32_t));
+    std::memcpy(words.data(), contents.data(), words.size() * sizeof(uint32_t));
+    if(words.empty()) {
+        std::cerr << "No instructions in section '" << section << "'"
+                  << std::endl;
+        return 1;
+    }
+
+    // both decoders must agree on every word
+    size_t mismatches = 0;
+    for(auto w : words) {
+        auto table = isa::inst::decodeInstruction(w);
+        auto linear = isa::inst::internal::decodeInstructionLinear(w);
+        if(table != linear) {
+            if(mismatches < 10) {
+                std::cerr << "Mismatch for 0x" << std::hex << std::setw(8)
+                          << std::setfill('0') << w << std::dec
+                          << ": table=" << isa::inst::Opcode::getName(table)
+                          << " linear=" << isa::inst::Opcode::getName(linear)
+                          << std::endl;
+            }
+            mismatches++;
+        }
+    }
+
+    uint64_t table_checksum = 0;
+    auto table_time = time([&]() {
+        for(size_t i = 0; i < iterations; i++) {
+            for(auto w : words) {
+                table_checksum += isa::inst::decodeInstruction(w);
+            }
+        }
+    });
+    uint64_t linear_checksum = 0;
+    auto linear_time = time([&]() {
+        for(size_t i = 0; i < iterations; i++) {
+            for(auto w : words) {
+                linear_checksum +=
+                    isa::inst::internal::decodeInstructionLinear(w);
+            }
+        }
+    });
+
+    double decoded = double(words.size()) * iterations;
+    std::cout << "decoded " << words.size() << " words from '" << section
+              << "' " << iterations << " times\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "table:  " << std::setw(8) << (table_time * 1e9 / decoded)
+              << " ns/word (checksum " << table_checksum << ")\n";
+    std::cout << "linear: " << std::setw(8) << (linear_time * 1e9 / decoded)
+              << " ns/word (checksum " << linear_checksum << ")\n";
+    std::cout << "speedup: " << (linear_time / table_time) << "x\n";
+    if(mismatches) {
+        std::cout << mismatches << " words decoded differently" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace microbench
@@ -0,0 +1,236 @@
+#include "microbench.h"
+
+#include "command/expr.h"
+#include "common/argparse.hpp"
+#include "hart/hart.h"
+#include "hart/hartstate.h"
+#include "mem/memory-image.h"
+
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <unistd.h>
+#include <vector>
+
+namespace microbench {
+
+namespace {
+constexpr types::Address PAGE = mem::Snapshot::PAGE_SIZE;
+constexpr types::Address CODE = 0x10000;
+constexpr types::Address STORES = 0x20000;
+constexpr types::Address READS = 0x22000;
+
+// pauses after each way it writes memory, s0 holds a file to read from
+//    lui a1, 0x20
+//    li t2, 100       # enough times for the jit to compile the loop
+//    jal ra, store
+//    ebreak
+//    lui a1, 0x20     # the loop is native from its first store now
+//    li t2, 100
+//    jal ra, store
+//    ebreak
+//    mv a0, s0
+//    lui a1, 0x22
+//    li a2, 16
+//    li a7, 63        # read
+//    ecall
+//    ebreak
+//    li a0, 0
+//    li a7, 93        # exit
+//    ecall
+// store:
+//    sd t2, 0(a1)
+//    addi t2, t2, -1
+//    bnez t2, store
+//    ret
+const uint32_t PROGRAM[] = {
+    0x000205b7, 0x06400393, 0x03c000ef, 0x00100073, 0x000205b7, 0x06400393,
+    0x02c000ef, 0x00100073, 0x00040513, 0x000225b7, 0x01000613, 0x03f00893,
+    0x00000073, 0x00100073, 0x00000513, 0x05d00893, 0x00000073, 0x0075b023,
+    0xfff38393, 0xfe039ce3, 0x00008067,
+};
+
+std::shared_ptr<mem::MemoryImage> makeImage(bool flat) {
+    auto m = std::make_shared<mem::MemoryImage>();
+    if(flat && !m->enableFlatBackend()) return nullptr;
+    return m;
+}
+
+// prints what went wrong, returns the number of failures
+class Checker {
+  private:
+    const char* backend;
+    int failures = 0;
+
+  public:
+    Checker(const char* backend) : backend(backend) {}
+    void operator()(
+        const mem::MemoryImage& m,
+        std::vector<types::Address> expected,
+        const char* what) {
+        auto pages = m.getDirtyPages();
+        if(pages == expected) return;
+        std::cerr << backend << ": " << what << ", got" << std::hex;
+        for(auto p : pages) {
+            std::cerr << " 0x" << p;
+        }
+        std::cerr << std::dec << std::endl;
+        failures++;
+    }
+    int getFailures() const { return failures; }
+};
+
+// the hart's own write paths, native stores from the jit and the host
+// writing for a syscall
+void checkHart(bool flat, bool jit, Checker& check) {
+    auto m = makeImage(flat);
+    m->allocate(CODE, sizeof(PROGRAM));
+    m->writeBlock(CODE, PROGRAM, sizeof(PROGRAM));
+    m->allocate(STORES, PAGE);
+    m->allocate(READS, PAGE);
+    int fds[2];
+    if(pipe(fds) != 0) {
+        std::cerr << "Could not make a pipe" << std::endl;
+        return;
+    }
+    (void)!write(fds[1], PROGRAM, 16);
+
+    hart::Hart hart(m);
+    if(jit && !hart.enableJit()) std::cerr << "The JIT is not supported\n";
+    hart.init();
+    auto& hs = hart.hs();
+    hs.rf().GPR[8] = uint64_t(fds[0]);
+    hs.setPC(CODE);
+    // nothing written while setting up counts
+    m->setDirtyTracking(true);
+    hs.start();
+    hart.startExecution();
+
+    const std::vector<types::Address> expected[] = {{STORES}, {STORES}, {READS}};
+    const char* what[] = {
+        "stores in a hot loop were not all tracked",
+        "stores to a page whose dirty bit was cleared were missed",
+        "the host writing for read was not tracked",
+    };
+    for(size_t phase = 0; phase < 3; phase++) {
+        hs.waitWhile(hart::ExecutionState::RUNNING);
+        if(!hs.isPaused() || !hs.waitUntilParked()) {
+            std::cerr << "The program did not pause" << std::endl;
+            break;
+        }
+        check(*m, expected[phase], what[phase]);
+        m->clearDirtyPages();
+        hs.resume();
+    }
+    hart.wait_till_done();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// the write paths that go around single stores
+void checkImage(bool flat, Checker& check) {
+    auto m = makeImage(flat);
+    m->allocate(STORES, 4 * PAGE);
+    m->fill(STORES, 1, 4 * PAGE);
+    m->setDirtyTracking(true);
+    check(*m, {}, "pages written before tracking started are dirty");
+
+    uint8_t buffer[16] = {};
+    m->writeBlock(STORES + PAGE - 8, buffer, sizeof(buffer));
+    check(
+        *m,
+        {STORES, STORES + PAGE},
+        "writeBlock over a page boundary was not tracked");
+    m->clearDirtyPages();
+
+    m->fill(STORES + PAGE + 8, 3, 16);
+    check(*m, {STORES + PAGE}, "fill was not tracked");
+    m->clearDirtyPages();
+
+    m->copy(STORES + 2 * PAGE - 8, STORES, 16);
+    check(
+        *m,
+        {STORES + PAGE, STORES + 2 * PAGE},
+        "copy over a page boundary was not tracked");
+    m->clearDirtyPages();
+
+    // the shell writing memory with [addr] = value
+    hart::Hart hart(m);
+    command::MemoryExpr(std::make_shared<command::NumberExpr>(STORES + 16))
+        .set(&hart.hs(), std::make_shared<command::NumberExpr>(4));
+    check(*m, {STORES}, "setting memory from the shell was not tracked");
+    m->clearDirtyPages();
+
+    m->deallocate(STORES + 2 * PAGE, 2 * PAGE);
+    check(
+        *m,
+        {STORES + 2 * PAGE, STORES + 3 * PAGE},
+        "deallocated pages are not dirty");
+    m->clearDirtyPages();
+
+    m->setDirtyTracking(false);
+    m->fill(STORES, 2, PAGE);
+    check(*m, {}, "pages written after tracking stopped are dirty");
+}
+} // namespace
+
+int dirty(int argc, const char** argv) {
+    argparse::ArgumentParser args("dirty");
+    args.add_argument("-p", "--pages")
+        .default_value(size_t(1024))
+        .action([](const std::string& value) { return size_t(std::stoull(value)); })
+        .help("number of pages to store to");
+    args.add_argument("-n", "--stores")
+        .default_value(size_t(1) << 24)
+        .action([](const std::string& value) { return size_t(std::stoull(value)); })
+        .help("number of stores to time");
+    args.add_argument("-f", "--flat")
+        .default_value(false)
+        .implicit_value(true)
+        .help("use the flat memory backend");
+    try {
+        args.parse_args(argc, argv);
+    } catch(const std::runtime_error& err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << args;
+        return 1;
+    }
+    auto pages = args.get<size_t>("--pages");
+    auto stores = args.get<size_t>("--stores");
+    auto flat = args.get<bool>("--flat");
+    if(flat && !makeImage(true)) {
+        std::cerr << "Flat memory is not supported on this host" << std::endl;
+        return 1;
+    }
+
+    // results are checked before anything is timed
+    Checker check(flat ? "flat" : "regions");
+    checkHart(flat, false, check);
+    checkHart(flat, true, check);
+    checkImage(flat, check);
+    if(check.getFailures() != 0) return 1;
+
+    std::cout << "storing " << stores << " doublewords spread over " << pages
+              << " pages\n";
+    std::cout << std::fixed << std::setprecision(2);
+    const char* modes[] = {"untracked", "tracked", "tracked and cleared"};
+    for(size_t mode = 0; mode < 3; mode++) {
+        auto m = makeImage(flat);
+        m->allocate(STORES, pages * PAGE);
+        m->setDirtyTracking(mode != 0);
+        mem::MemoryImage::BareView view(*m);
+        auto t = time([&]() {
+            for(size_t i = 0; i < stores; i++) {
+                // a new pass over the pages every time the index wraps
+                auto p = i % pages;
+                if(mode == 2 && p == 0) m->clearDirtyPages();
+                view.doubleword(STORES + p * PAGE) = i;
+            }
+        });
+        std::cout << std::setw(20) << modes[mode] << ": " << std::setw(8)
+                  << (t * 1e9 / double(stores)) << " ns/store\n";
+    }
+    return 0;
+}
+
+} // namespace microbench
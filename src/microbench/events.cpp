@@ -0,0 +1,113 @@
+#include "microbench.h"
+
+#include "common/argparse.hpp"
+#include "event/event.h"
+#include "hart/isa/register.h"
+
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace microbench {
+
+namespace {
+// the event core as it was before delegates, kept here to compare against.
+// callbacks are std::functions copied on every call and register events
+// carry the class name
+template <typename... Types> class FunctionEvent {
+    std::vector<std::function<void(Types...)>> callbacks;
+
+  public:
+    void operator()(Types... args) {
+        for(auto c : callbacks) {
+            c(args...);
+        }
+    }
+    void addListener(std::function<void(Types...)> c) {
+        callbacks.push_back(c);
+    }
+};
+} // namespace
+
+int events(int argc, const char** argv) {
+    argparse::ArgumentParser args("events");
+    args.add_argument("-l", "--listeners")
+        .default_value(size_t(4))
+        .action([](const std::string& value) { return size_t(std::stoull(value)); })
+        .help("largest number of listeners to attach");
+    args.add_argument("-n", "--events")
+        .default_value(size_t(1) << 22)
+        .action([](const std::string& value) { return size_t(std::stoull(value)); })
+        .help("number of events to fire for each listener count");
+    try {
+        args.parse_args(argc, argv);
+    } catch(const std::runtime_error& err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << args;
+        return 1;
+    }
+
+    auto max_listeners = args.get<size_t>("--listeners");
+    auto count = args.get<size_t>("--events");
+
+    // fire register write events the way RegisterProxy does
+    std::string classname = "GPR";
+    auto class_id = RegisterClass::internClassName(classname);
+    std::cout << "firing " << count << " register write events\n";
+    std::cout << std::fixed << std::setprecision(2);
+    for(size_t listeners = 0; listeners <= max_listeners;
+        listeners = listeners ? listeners * 2 : 1) {
+        uint64_t sink_before = 0;
+        FunctionEvent<std::string, uint64_t, uint64_t, uint64_t> before;
+        for(size_t l = 0; l < listeners; l++) {
+            before.addListener([&sink_before](
+                                   std::string name,
+                                   uint64_t idx,
+                                   uint64_t value,
+                                   uint64_t old) {
+                sink_before += name.size() + idx + value - old;
+            });
+        }
+        auto t_before = time([&]() {
+            for(size_t i = 0; i < count; i++) {
+                before(classname, i % 32, i, i - 1);
+                doNotOptimize(before);
+            }
+        });
+
+        uint64_t sink_after = 0;
+        event::Event<RegisterClass::ClassID, uint64_t, uint64_t, uint64_t>
+            after;
+        for(size_t l = 0; l < listeners; l++) {
+            after.addListener([&sink_after](
+                                  RegisterClass::ClassID rc,
+                                  uint64_t idx,
+                                  uint64_t value,
+                                  uint64_t old) {
+                sink_after += RegisterClass::getClassName(rc).size() + idx +
+                              value - old;
+            });
+        }
+        auto t_after = time([&]() {
+            for(size_t i = 0; i < count; i++) {
+                if(!after.empty()) after(class_id, i % 32, i, i - 1);
+                doNotOptimize(after);
+            }
+        });
+
+        if(sink_before != sink_after) {
+            std::cerr << "Listeners saw different events" << std::endl;
+            return 1;
+        }
+        std::cout << std::setw(4) << listeners << " listeners: "
+                  << std::setw(10) << (double(count) / t_before / 1e6)
+                  << " M events/s before, " << std::setw(10)
+                  << (double(count) / t_after / 1e6)
+                  << " M events/s after (checksum " << sink_after << ")\n";
+    }
+    return 0;
+}
+
+} // namespace microbench
@@ -0,0 +1,48 @@
+#include "microbench.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+static const std::vector<microbench::Benchmark> benchmarks = {
+    {"decode",
+     "decode every word of an ELF section with each decoder",
+     microbench::decode},
+    {"memory",
+     "load from memory images holding more and more regions",
+     microbench::memory},
+    {"events",
+     "fire register events through the old and new event cores",
+     microbench::events},
+    {"snapshot",
+     "check snapshot, restore, and diff, then time restoring written pages",
+     microbench::snapshot},
+    {"dirty",
+     "check which write paths mark pages dirty, then time tracked stores",
+     microbench::dirty},
+    {"counts",
+     "check instruction counts on self-modifying code, then time counting",
+     microbench::counts},
+};
+
+static void usage(const char* name) {
+    std::cerr << "Usage: " << name << " BENCHMARK [ARGS...]\n\n"
+              << "Benchmarks:\n";
+    for(const auto& b : benchmarks) {
+        std::cerr << "  " << b.name << "\t" << b.description << "\n";
+    }
+}
+
+int main(int argc, const char** argv) {
+    if(argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string name = argv[1];
+    for(const auto& b : benchmarks) {
+        if(b.name == name) return b.run(argc - 1, argv + 1);
+    }
+    std::cerr << "Unknown benchmark '" << name << "'\n\n";
+    usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,106 @@
+#include "microbench.h"
+
+#include "common/argparse.hpp"
+#include "mem/memory-image.h"
+
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace microbench {
+
+int memory(int argc, const char** argv) {
+    argparse::ArgumentParser args("memory");
+    args.add_argument("-r", "--regions")
+        .default_value(size_t(16384))
+        .action([](const std::string& value) { return size_t(std::stoull(value)); })
+        .help("largest number of regions to allocate");
+    args.add_argument("-s", "--size")
+        .default_value(size_t(4096))
+        .action([](const std::string& value) { return size_t(std::stoull(value)); })
+        .help("size of each region in bytes at the largest region count");
+    args.add_argument("-t", "--touched")
+        .default_value(size_t(1024))
+        .action([](const std::string& value) { return size_t(std::stoull(value)); })
+        .help("number of words loaded from, each in a page of its own");
+    args.add_argument("-n", "--accesses")
+        .default_value(size_t(1) << 24)
+        .action([](const std::string& value) { return size_t(std::stoull(value)); })
+        .help("number of loads to time for each region count");
+    args.add_argument("-f", "--flat")
+        .default_value(false)
+        .implicit_value(true)
+        .help("use the flat memory backend");
+    try {
+        args.parse_args(argc, argv);
+    } catch(const std::runtime_error& err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << args;
+        return 1;
+    }
+
+    auto max_regions = args.get<size_t>("--regions");
+    auto size = args.get<size_t>("--size");
+    auto touched = args.get<size_t>("--touched");
+    auto accesses = args.get<size_t>("--accesses");
+    auto flat = args.get<bool>("--flat");
+    // the same memory is split into more regions each round, and the same
+    // words are loaded from it. so only the number of regions changes
+    constexpr size_t PAGE = 4096;
+    auto span = max_regions * size;
+    auto pages = span / PAGE;
+    if(size % PAGE != 0 || touched == 0 || touched > pages) {
+        std::cerr << "Regions must be whole pages, with at least as many "
+                     "pages as words loaded"
+                  << std::endl;
+        return 1;
+    }
+
+    // a page for each word, spread over the memory. the stride is odd, so
+    // no page is picked twice when the page count is a power of two
+    std::vector<types::Address> offsets(touched);
+    for(size_t i = 0; i < touched; i++) {
+        auto page = (i * 7919) % pages;
+        auto w = (i * 31) % (PAGE / sizeof(uint32_t));
+        offsets[i] = page * PAGE + w * sizeof(uint32_t);
+    }
+
+    std::cout << "loading " << accesses << " words from " << touched
+              << " pages of " << (span >> 20) << " MiB\n";
+    std::cout << std::fixed << std::setprecision(2);
+    for(size_t regions = 1; regions <= max_regions; regions *= 4) {
+        // lay regions out back to back, the way brk grows the heap
+        mem::MemoryImage m;
+        if(flat && !m.enableFlatBackend()) {
+            std::cerr << "Flat memory is not supported on this host"
+                      << std::endl;
+            return 1;
+        }
+        types::Address base = 0x100000000;
+        auto region_size = span / regions;
+        for(size_t r = 0; r + 1 < regions; r++) {
+            m.allocate(base + r * region_size, region_size);
+        }
+        // the last region takes what does not divide evenly
+        auto last = (regions - 1) * region_size;
+        m.allocate(base + last, span - last);
+        std::vector<types::Address> addrs(touched);
+        for(size_t i = 0; i < touched; i++) {
+            addrs[i] = base + offsets[i];
+        }
+
+        mem::MemoryImage::BareView view(m);
+        uint64_t checksum = 0;
+        auto t = time([&]() {
+            for(size_t i = 0; i < accesses; i++) {
+                checksum += uint32_t(view.word(addrs[i % addrs.size()]));
+            }
+        });
+        std::cout << std::setw(8) << regions << " regions: " << std::setw(8)
+                  << (t * 1e9 / double(accesses))
+                  << " ns/load (checksum " << checksum << ")\n";
+    }
+    return 0;
+}
+
+} // namespace microbench
@@ -0,0 +1,42 @@
+#ifndef ZIRCON_MICROBENCH_MICROBENCH_H_
+#define ZIRCON_MICROBENCH_MICROBENCH_H_
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace microbench {
+
+// each benchmark gets the arguments after its name, with argv[0] set to the
+// benchmark name
+using BenchmarkFunction = int (*)(int argc, const char** argv);
+struct Benchmark {
+    std::string name;
+    std::string description;
+    BenchmarkFunction run;
+};
+
+int decode(int argc, const char** argv);
+int memory(int argc, const char** argv);
+int events(int argc, const char** argv);
+int snapshot(int argc, const char** argv);
+int dirty(int argc, const char** argv);
+int counts(int argc, const char** argv);
+
+// makes the compiler assume value is read and memory is written, so work
+// whose result goes unused is not optimized out of a timed loop
+template <typename T> void doNotOptimize(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// time how long it takes to run f, in seconds
+template <typename F> double time(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+} // namespace microbench
+
+#endif
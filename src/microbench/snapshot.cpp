@@ -0,0 +1,201 @@
+#include "microbench.h"
+
+#include "common/argparse.hpp"
+#include "mem/memory-image.h"
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace microbench {
+
+namespace {
+constexpr types::Address PAGE = mem::Snapshot::PAGE_SIZE;
+constexpr types::Address BASE = 0x100000000;
+
+std::unique_ptr<mem::MemoryImage> makeImage(bool flat) {
+    auto m = std::make_unique<mem::MemoryImage>();
+    if(flat && !m->enableFlatBackend()) return nullptr;
+    return m;
+}
+
+// the n bytes at addr, unallocated bytes read as zero
+std::vector<uint8_t> bytes(mem::MemoryImage& m, types::Address addr, size_t n) {
+    std::vector<uint8_t> v(n);
+    for(size_t i = 0; i < n; i++) {
+        if(auto p = m.raw(addr + i)) v[i] = *p;
+    }
+    return v;
+}
+
+// prints what went wrong, returns the number of failures
+class Checker {
+  private:
+    const char* backend;
+    int failures = 0;
+
+  public:
+    Checker(const char* backend) : backend(backend) {}
+    void operator()(bool ok, const char* what) {
+        if(ok) return;
+        std::cerr << backend << ": " << what << std::endl;
+        failures++;
+    }
+    int getFailures() const { return failures; }
+};
+
+// restoring an older snapshot leaves the newer ones usable, and pages first
+// written after the newer one was taken are saved in both
+void checkNested(mem::MemoryImage& m, Checker& check) {
+    m.allocate(BASE, 2 * PAGE);
+    m.fill(BASE, 0xa1, PAGE);
+    auto first = m.snapshot();
+    m.fill(BASE, 0xb2, PAGE);
+    auto second = m.snapshot();
+    m.fill(BASE, 0xc3, PAGE);
+    m.fill(BASE + PAGE, 0xd4, PAGE);
+
+    m.restore(*first);
+    check(
+        bytes(m, BASE, PAGE) == std::vector<uint8_t>(PAGE, 0xa1),
+        "restoring the older snapshot did not bring back its page");
+    check(
+        bytes(m, BASE + PAGE, PAGE) == std::vector<uint8_t>(PAGE, 0),
+        "a page written after both snapshots was not saved in the older");
+    check(m.diff(*first).empty(), "diff after restoring is not empty");
+    m.restore(*second);
+    check(
+        bytes(m, BASE, PAGE) == std::vector<uint8_t>(PAGE, 0xb2),
+        "the newer snapshot was spoiled by restoring the older one");
+    check(
+        m.diff(*first) == std::vector<types::Address>{BASE},
+        "diff against the older snapshot is wrong");
+    m.restore(*first);
+    check(
+        bytes(m, BASE, PAGE) == std::vector<uint8_t>(PAGE, 0xa1),
+        "restoring the older snapshot a second time failed");
+}
+
+// regions that were split, grown, and added after the snapshot go back to
+// the layout it captured
+void checkLayout(mem::MemoryImage& m, Checker& check) {
+    m.allocate(BASE, 3 * PAGE);
+    m.fill(BASE, 0x5a, 3 * PAGE);
+    auto allocated = m.getAllocatedBytes();
+    auto s = m.snapshot();
+
+    m.deallocate(BASE + PAGE, PAGE);
+    m.allocate(BASE + 3 * PAGE, 2 * PAGE);
+    m.fill(BASE + 3 * PAGE, 0x11, 2 * PAGE);
+    m.allocate(BASE + 16 * PAGE, PAGE);
+    m.allocate(BASE + PAGE, PAGE / 2);
+    m.fill(BASE + PAGE, 0x22, PAGE / 2);
+
+    m.restore(*s);
+    check(
+        m.isAllocated(BASE, 3 * PAGE),
+        "the deallocated page was not allocated again");
+    check(
+        m.isFree(BASE + 3 * PAGE, 14 * PAGE),
+        "memory allocated after the snapshot is still there");
+    check(
+        m.getAllocatedBytes() == allocated,
+        "the allocated size is not what it was");
+    check(
+        bytes(m, BASE, 3 * PAGE) == std::vector<uint8_t>(3 * PAGE, 0x5a),
+        "the contents are not what they were");
+    check(m.diff(*s).empty(), "diff after restoring is not empty");
+
+    // growing back into restored memory starts from zero
+    m.allocate(BASE + 3 * PAGE, PAGE);
+    check(
+        bytes(m, BASE + 3 * PAGE, PAGE) == std::vector<uint8_t>(PAGE, 0),
+        "memory grown after restoring is not zeroed");
+}
+
+// a page that is only partly allocated compares the unallocated bytes as
+// zero, so a deallocation shows up in diff only if it hid nonzero bytes
+void checkPartial(mem::MemoryImage& m, Checker& check) {
+    m.allocate(BASE + 100, 50);
+    m.fill(BASE + 100, 0xab, 50);
+    m.allocate(BASE + PAGE + 100, 50);
+    auto s = m.snapshot();
+    check(m.diff(*s).empty(), "diff of a fresh snapshot is not empty");
+
+    m.fill(BASE + 120, 0xcd, 1);
+    check(
+        m.diff(*s) == std::vector<types::Address>{BASE},
+        "a write to a partial page is missing from diff");
+    m.deallocate(BASE + 130, 20);
+    m.deallocate(BASE + PAGE + 100, 50);
+    check(
+        m.diff(*s) == std::vector<types::Address>{BASE},
+        "diff of deallocated bytes does not treat them as zero");
+
+    m.restore(*s);
+    check(m.diff(*s).empty(), "diff after restoring is not empty");
+    check(
+        bytes(m, BASE + 100, 50) == std::vector<uint8_t>(50, 0xab),
+        "the partial page was not restored");
+    check(
+        m.isAllocated(BASE + PAGE + 100, 50) && m.isFree(BASE + 150, 100),
+        "the partial layout was not restored");
+}
+} // namespace
+
+int snapshot(int argc, const char** argv) {
+    argparse::ArgumentParser args("snapshot");
+    args.add_argument("-p", "--pages")
+        .default_value(size_t(4096))
+        .action([](const std::string& value) { return size_t(std::stoull(value)); })
+        .help("largest number of pages to write between snapshot and restore");
+    args.add_argument("-f", "--flat")
+        .default_value(false)
+        .implicit_value(true)
+        .help("use the flat memory backend");
+    try {
+        args.parse_args(argc, argv);
+    } catch(const std::runtime_error& err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << args;
+        return 1;
+    }
+    auto max_pages = args.get<size_t>("--pages");
+    auto flat = args.get<bool>("--flat");
+    if(flat && !makeImage(true)) {
+        std::cerr << "Flat memory is not supported on this host" << std::endl;
+        return 1;
+    }
+
+    // results are checked before anything is timed
+    Checker check(flat ? "flat" : "regions");
+    for(auto f : {checkNested, checkLayout, checkPartial}) {
+        f(*makeImage(flat), check);
+    }
+    if(check.getFailures() != 0) return 1;
+
+    std::cout << "restoring snapshots after writing a byte to each page\n";
+    std::cout << std::fixed << std::setprecision(2);
+    for(size_t pages = 1; pages <= max_pages; pages *= 4) {
+        auto m = makeImage(flat);
+        m->allocate(BASE, pages * PAGE);
+        auto s = m->snapshot();
+        auto t = time([&]() {
+            for(size_t p = 0; p < pages; p++) {
+                m->fill(BASE + p * PAGE, uint8_t(p + 1), 1);
+            }
+            m->restore(*s);
+        });
+        if(!m->diff(*s).empty()) {
+            std::cerr << "Restoring left pages changed" << std::endl;
+            return 1;
+        }
+        std::cout << std::setw(8) << pages << " pages: " << std::setw(10)
+                  << (t * 1e6 / double(pages)) << " us/page\n";
+    }
+    return 0;
+}
+
+} // namespace microbench
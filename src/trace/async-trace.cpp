@@ -0,0 +1,49 @@
+#include "async-trace.h"
+
+#include <chrono>
+
+namespace trace {
+
+AsyncTrace::AsyncTrace(Consumer consume, Flusher flush, size_t capacity)
+    : ring(capacity), consume(std::move(consume)), flush(std::move(flush)),
+      stopping(false), consumer(&AsyncTrace::run, this) {}
+
+AsyncTrace::~AsyncTrace() { stop(); }
+
+void AsyncTrace::stop() {
+    if(!consumer.joinable()) return;
+    stopping.store(true, std::memory_order_release);
+    consumer.join();
+}
+
+void AsyncTrace::pushSlow(const Record& r) {
+    while(!ring.tryPush(r)) {
+        std::this_thread::yield();
+    }
+}
+
+void AsyncTrace::run() {
+    Record batch[256];
+    bool written = false;
+    while(true) {
+        // read the flag before popping, anything pushed before stop() is
+        // then seen by this pop or a later one
+        bool done = stopping.load(std::memory_order_acquire);
+        auto n = ring.pop(batch, sizeof(batch) / sizeof(batch[0]));
+        for(size_t i = 0; i < n; i++) {
+            consume(batch[i]);
+        }
+        if(n != 0) {
+            written = true;
+            continue;
+        }
+        if(written) {
+            flush();
+            written = false;
+        }
+        if(done) break;
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+} // namespace trace
@@ -0,0 +1,77 @@
+#ifndef ZIRCON_TRACE_ASYNC_TRACE_H_
+#define ZIRCON_TRACE_ASYNC_TRACE_H_
+
+#include "ring.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+namespace trace {
+
+// one traced event, small and plain so the hart thread can hand it off
+// without formatting anything
+struct Record {
+    enum class Kind : uint8_t {
+        INST,
+        REG_READ,
+        REG_WRITE,
+        MEM_READ,
+        MEM_WRITE,
+        MEM_BLOCK_READ,
+        MEM_BLOCK_WRITE,
+        ALLOCATION,
+    };
+    Kind kind;
+    // size of a memory access in bytes
+    uint8_t size;
+    // instruction word or register class id
+    uint32_t id;
+    // pc, register index or memory address
+    uint64_t addr;
+    // value read or written, or the size of a block
+    uint64_t value;
+    uint64_t old_value;
+};
+
+// hands records from the hart thread to a consumer thread, which formats and
+// writes them. when the ring is full the hart waits for the consumer
+class AsyncTrace {
+  public:
+    using Consumer = std::function<void(const Record&)>;
+    using Flusher = std::function<void()>;
+    static constexpr size_t DEFAULT_CAPACITY = 1 << 16;
+
+  private:
+    Ring<Record> ring;
+    Consumer consume;
+    Flusher flush;
+    std::atomic<bool> stopping;
+    std::thread consumer;
+
+    void run();
+    void pushSlow(const Record& r);
+
+  public:
+    // consume is called for every record in order, flush whenever the
+    // consumer runs out of records
+    AsyncTrace(
+        Consumer consume,
+        Flusher flush,
+        size_t capacity = DEFAULT_CAPACITY);
+    ~AsyncTrace();
+    AsyncTrace(const AsyncTrace&) = delete;
+    AsyncTrace& operator=(const AsyncTrace&) = delete;
+
+    // only ever called from one thread at a time
+    void push(const Record& r) {
+        if(!ring.tryPush(r)) pushSlow(r);
+    }
+    // write out everything pushed so far and stop the consumer
+    void stop();
+};
+
+} // namespace trace
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef ZIRCON_TRACE_RING_H_
+#define ZIRCON_TRACE_RING_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+namespace trace {
+
+// a fixed size queue for exactly one producer thread and one consumer thread,
+// neither of which ever takes a lock. the capacity must be a power of 2
+template <typename T> class Ring {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+  private:
+    size_t capacity;
+    std::unique_ptr<T[]> slots;
+    // each side keeps a cached copy of the other side's index, so it only
+    // touches the other side's cache line when the ring looks full or empty
+    struct alignas(64) {
+        std::atomic<size_t> tail{0};
+        size_t head = 0;
+    } producer;
+    struct alignas(64) {
+        std::atomic<size_t> head{0};
+        size_t tail = 0;
+    } consumer;
+
+  public:
+    explicit Ring(size_t capacity)
+        : capacity(capacity), slots(std::make_unique<T[]>(capacity)) {
+        assert(capacity != 0 && (capacity & (capacity - 1)) == 0);
+    }
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    // producer side, false if the ring is full
+    bool tryPush(const T& value) {
+        auto tail = producer.tail.load(std::memory_order_relaxed);
+        if(tail - producer.head == capacity) {
+            producer.head = consumer.head.load(std::memory_order_acquire);
+            if(tail - producer.head == capacity) return false;
+        }
+        slots[tail & (capacity - 1)] = value;
+        producer.tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, pops up to max values into out and returns how many
+    size_t pop(T* out, size_t max) {
+        auto head = consumer.head.load(std::memory_order_relaxed);
+        if(consumer.tail == head) {
+            consumer.tail = producer.tail.load(std::memory_order_acquire);
+            if(consumer.tail == head) return 0;
+        }
+        auto n = std::min(max, consumer.tail - head);
+        for(size_t i = 0; i < n; i++) {
+            out[i] = slots[(head + i) & (capacity - 1)];
+        }
+        consumer.head.store(head + n, std::memory_order_release);
+        return n;
+    }
+};
+
+} // namespace trace
+
+#endif
@@ -1,16 +1,23 @@
 #include "stats.h"
 
-#include "hart/isa/inst-execute.h"
 #include "hart/isa/inst.h"
+#include "mem/memory-image.h"
 
+#include <fstream>
 #include <functional>
 #include <iomanip>
 #include <sstream>
 
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+    #include <linux/perf_event.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
 namespace internal {
 static std::map<
     std::string,
-    std::function<void(const hart::HartState&, float& counter)>>
+    std::function<void(isa::inst::Opcode op, uint64_t n, float& counter)>>
     counter_funcs;
 static std::string counter_names[] = {
 #define COUNTER(name, ...) name,
@@ -24,7 +31,8 @@ static size_t number_counters = 0
 void initCounterMap(std::map<std::string, float>& m) {
 #define COUNTER(name, expression)                                              \
     m[name] = 0;                                                               \
-    counter_funcs[name] = []([[maybe_unused]] const hart::HartState& hs,       \
+    counter_funcs[name] = []([[maybe_unused]] isa::inst::Opcode op,            \
+                             [[maybe_unused]] uint64_t n,                      \
                              [[maybe_unused]] float& counter) {                \
         do {                                                                   \
             expression;                                                        \
@@ -35,8 +43,7 @@ void initCounterMap(std::map<std::string, float>& m) {
 
 static std::map<
     std::string,
-    std::function<
-        float(const hart::HartState&, const std::map<std::string, float>&)>>
+    std::function<float(const std::map<std::string, float>&)>>
     computed_funcs;
 static std::string computed_names[] = {
 #define COMPUTED(name, ...) name,
@@ -51,8 +58,7 @@ void initComputedMap(std::map<std::string, float>& m) {
 #define COMPUTED(name, expression)                                             \
     m[name] = 0;                                                               \
     computed_funcs[name] =                                                     \
-        []([[maybe_unused]] const hart::HartState& hs,                         \
-           [[maybe_unused]] std::map<std::string, float> counters) -> float {  \
+        []([[maybe_unused]] std::map<std::string, float> counters) -> float {  \
         do {                                                                   \
             expression;                                                        \
         } while(0);                                                            \
@@ -78,28 +84,91 @@ void initComputedMap(std::map<std::string, float>& m) {
 //     return computed;
 // }
 
+// a size in kB from /proc/self/status, 0 if it cannot be read
+static uint64_t readProcStatus(
+    const std::string& key,
+    const std::string& file = "/proc/self/status") {
+    std::ifstream status(file);
+    std::string line;
+    while(std::getline(status, line)) {
+        if(line.rfind(key + ":", 0) == 0) {
+            return std::stoull(line.substr(key.size() + 1));
+        }
+    }
+    return 0;
+}
+
+// a counter for data TLB reads of this process and the threads it starts
+// later, -1 if the host does not allow it
+static int openDTLBCounter([[maybe_unused]] bool misses) {
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  ((misses ? PERF_COUNT_HW_CACHE_RESULT_MISS
+                           : PERF_COUNT_HW_CACHE_RESULT_ACCESS)
+                   << 16);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+    return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+    return -1;
+#endif
+}
+static uint64_t readCounter([[maybe_unused]] int fd) {
+    uint64_t value = 0;
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+    if(::read(fd, &value, sizeof(value)) != sizeof(value)) return 0;
+#endif
+    return value;
+}
+static void closeCounter([[maybe_unused]] int fd) {
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+    if(fd >= 0) close(fd);
+#endif
+}
+
 } // namespace internal
 
-Stats::Stats() {
+Stats::Stats() : guest_allocated(0), dtlb_loads(-1), dtlb_misses(-1) {
     internal::initCounterMap(counters);
     internal::initComputedMap(computed_counters);
 }
+Stats::~Stats() {
+    internal::closeCounter(dtlb_loads);
+    internal::closeCounter(dtlb_misses);
+}
 
-void Stats::count(const hart::HartState& hs) {
-    for(size_t idx = 0; idx < internal::number_counters; idx++) {
-        const auto& key = internal::counter_names[idx];
-        auto& counter_value = counters[key];
-        auto func = internal::counter_funcs[key];
-        func(hs, counter_value);
+void Stats::startHostCounters() {
+    dtlb_loads = internal::openDTLBCounter(false);
+    dtlb_misses = internal::openDTLBCounter(true);
+}
+
+void Stats::countInstructions(const std::vector<uint64_t>& opcode_counts) {
+    for(size_t op = 0; op < opcode_counts.size(); op++) {
+        if(opcode_counts[op] == 0) continue;
+        for(size_t idx = 0; idx < internal::number_counters; idx++) {
+            const auto& key = internal::counter_names[idx];
+            auto& counter_value = counters[key];
+            auto func = internal::counter_funcs[key];
+            func(isa::inst::Opcode(op), opcode_counts[op], counter_value);
+        }
     }
     for(size_t idx = 0; idx < internal::number_computed; idx++) {
         const auto& key = internal::computed_names[idx];
         auto& computed_value = computed_counters[key];
         auto func = internal::computed_funcs[key];
-        computed_value = func(hs, counters);
+        computed_value = func(counters);
     }
 }
 
+void Stats::countMemory(const mem::MemoryImage& m) {
+    guest_allocated = m.getAllocatedBytes();
+}
+
 std::string Stats::dump() {
     std::stringstream ss;
 
@@ -125,6 +194,44 @@ std::string Stats::dump() {
            << std::setprecision(2) << computed_value;
         ss << "\n";
     }
+    ss << " Memory\n";
+    std::pair<std::string, uint64_t> memory[] = {
+        {"guest memory allocated (KiB)", guest_allocated >> 10},
+        {"host resident set (KiB)", internal::readProcStatus("VmRSS")},
+        {"host peak resident set (KiB)", internal::readProcStatus("VmHWM")},
+        {"host huge pages (KiB)",
+         internal::readProcStatus("AnonHugePages", "/proc/self/smaps_rollup")},
+    };
+    for(const auto& [key, value] : memory) {
+        ss << "  ";
+        ss << std::setfill('.') << std::setw(70) << std::left << key;
+        ss << std::setfill('.') << std::setw(8) << std::right << value;
+        ss << "\n";
+    }
+    ss << " Host\n";
+    if(dtlb_loads >= 0 && dtlb_misses >= 0) {
+        auto loads = internal::readCounter(dtlb_loads);
+        auto misses = internal::readCounter(dtlb_misses);
+        std::pair<std::string, uint64_t> tlb[] = {
+            {"host dTLB loads", loads},
+            {"host dTLB load misses", misses},
+        };
+        for(const auto& [key, value] : tlb) {
+            ss << "  ";
+            ss << std::setfill('.') << std::setw(70) << std::left << key;
+            ss << std::setfill('.') << std::setw(8) << std::right << value;
+            ss << "\n";
+        }
+        ss << "  ";
+        ss << std::setfill('.') << std::setw(70) << std::left
+           << "host dTLB load miss rate (%)";
+        ss << std::setfill('.') << std::setw(8) << std::right << std::fixed
+           << std::setprecision(2)
+           << (loads ? 100.0 * double(misses) / double(loads) : 0.0);
+        ss << "\n";
+    } else {
+        ss << "  host dTLB counters are not available\n";
+    }
 
     return ss.str();
 }
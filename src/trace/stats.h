@@ -2,21 +2,39 @@
 #ifndef ZIRCON_TRACE_STATS_H_
 #define ZIRCON_TRACE_STATS_H_
 
+#include <cstdint>
 #include <map>
 #include <string>
+#include <vector>
 
-namespace hart {
-class HartState;
+namespace mem {
+class MemoryImage;
 }
 
 class Stats {
   private:
     std::map<std::string, float> counters;
     std::map<std::string, float> computed_counters;
+    uint64_t guest_allocated;
+    // host perf counters for data TLB loads and misses, -1 if they could not
+    // be opened
+    int dtlb_loads;
+    int dtlb_misses;
 
   public:
     Stats();
-    void count(const hart::HartState&);
+    ~Stats();
+    Stats(const Stats&) = delete;
+    Stats& operator=(const Stats&) = delete;
+    // add up the counters from the number of times each opcode was
+    // executed, indexed by opcode
+    void countInstructions(const std::vector<uint64_t>& opcode_counts);
+    // record how much memory the guest has allocated, for the memory section
+    // of the dump
+    void countMemory(const mem::MemoryImage&);
+    // start counting host data TLB misses, for the host section of the dump.
+    // threads started afterwards are counted too
+    void startHostCounters();
 
     std::string dump();
 };
@@ -37,17 +37,19 @@ void emulate_impl(std::string filename) {
                   << isa::inst::disassemble(inst, hs().pc) << std::endl;
     });
     hart.addRegisterReadListener(
-        [reg_log](std::string classname, uint64_t idx, uint64_t value) {
-            *reg_log << "RD " << classname << "[" << common::Format::dec << idx
+        [reg_log](RegisterClass::ClassID rc, uint64_t idx, uint64_t value) {
+            *reg_log << "RD " << RegisterClass::getClassName(rc) << "["
+                     << common::Format::dec << idx
                      << "] = " << common::Format::doubleword << (uint64_t)value
                      << std::endl;
         });
     hart.addRegisterWriteListener([reg_log](
-                                      std::string classname,
+                                      RegisterClass::ClassID rc,
                                       uint64_t idx,
                                       uint64_t value,
                                       uint64_t oldvalue) {
-        *reg_log << "WR " << classname << "[" << common::Format::dec << idx
+        *reg_log << "WR " << RegisterClass::getClassName(rc) << "["
+                 << common::Format::dec << idx
                  << "] = " << common::Format::doubleword << (uint64_t)value
                  << "; OLD VALUE = " << common::Format::doubleword << oldvalue
                  << std::endl;
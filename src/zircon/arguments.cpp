@@ -7,9 +7,11 @@
 #include "hart/isa/inst-execute.h"
 #include "hart/isa/inst.h"
 #include "ishell/parser/parser.h"
+#include "trace/async-trace.h"
 
 #include <algorithm>
 #include <iomanip>
+#include <memory>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <unordered_map>
@@ -108,6 +110,12 @@ MainArguments::MainArguments()
     program_args.add_argument("--inst-log")
         .metavar("LOGFILE")
         .help("instructions log file");
+    program_args.add_argument("--inst-filter")
+        .append()
+        .metavar("CLASS")
+        .help("only trace instructions in CLASS, one of branch, jump, load, "
+              "store, system, R-type to J-type, or an instruction name. can "
+              "be given more than once");
 
     program_args.add_argument("--csv")
         .default_value(false)
@@ -122,6 +130,10 @@ MainArguments::MainArguments()
     program_args.add_argument("--reg-log")
         .metavar("LOGFILE")
         .help("register accesses log file");
+    program_args.add_argument("--reg-filter")
+        .append()
+        .metavar("REG")
+        .help("only trace accesses to REG, can be given more than once");
 
     program_args.add_argument("-M", "--mem")
         .default_value(false)
@@ -130,12 +142,44 @@ MainArguments::MainArguments()
     program_args.add_argument("--mem-log")
         .metavar("LOGFILE")
         .help("memory accesses log file");
+    program_args.add_argument("--mem-range")
+        .append()
+        .metavar("START-END")
+        .help("only trace accesses to [START, END), can be given more than "
+              "once. allocations are traced when they overlap a range, and "
+              "untraced accesses run at full speed");
+
+    program_args.add_argument("--async-trace")
+        .default_value(false)
+        .implicit_value(true)
+        .help("format and write traces on a separate thread, trace output "
+              "may then lag behind the program's own output");
 
     program_args.add_argument("--stats")
         .default_value(false)
         .implicit_value(true)
         .help("dump runtime statistics");
 
+    program_args.add_argument("--jit")
+        .default_value(false)
+        .implicit_value(true)
+        .help("compile hot code to native code");
+
+    program_args.add_argument("--jit-verify")
+        .default_value(false)
+        .implicit_value(true)
+        .help("compile hot code to native code and check it against the "
+              "interpreter");
+
+    program_args.add_argument("--flat-memory")
+        .default_value(false)
+        .implicit_value(true)
+        .help("place guest memory in one reserved range of host memory");
+    program_args.add_argument("--hugepages")
+        .default_value(false)
+        .implicit_value(true)
+        .help("back large guest regions with transparent huge pages");
+
     program_args.add_argument("-control")
         .append()
         .metavar("CONTROL")
@@ -239,6 +283,30 @@ void MainArguments::parse(int argc, const char** argv, const char** envp) {
         }
     }
 
+    for(auto r : program_args.get<std::vector<std::string>>("--mem-range")) {
+        auto dash = r.find('-');
+        try {
+            if(dash == std::string::npos) throw std::invalid_argument(r);
+            auto start = std::stoull(r.substr(0, dash), nullptr, 0);
+            auto end = std::stoull(r.substr(dash + 1), nullptr, 0);
+            if(end <= start) throw std::invalid_argument(r);
+            trace_ranges.add(start, end - start);
+        } catch(const std::logic_error&) {
+            throw ArgumentException("Bad memory range '" + r + "'");
+        }
+    }
+    for(auto r : program_args.get<std::vector<std::string>>("--reg-filter")) {
+        auto reg = isa::rf::parseRegister(r);
+        if(!reg) throw ArgumentException("Unknown register '" + r + "'");
+        trace_registers[reg->rct] |= RegisterClass::Mask(1) << reg->idx;
+    }
+    for(auto c : program_args.get<std::vector<std::string>>("--inst-filter")) {
+        auto opcodes = isa::inst::OpcodeSet::lookupName(c);
+        if(opcodes.empty())
+            throw ArgumentException("Unknown instruction class '" + c + "'");
+        trace_opcodes |= opcodes;
+    }
+
     input = (new std::ifstream(filename, std::ios::binary));
     if(!input || (input && !input->is_open())) {
         throw ArgumentException("Failed to open '" + filename + "'");
@@ -279,138 +347,204 @@ std::ifstream MainArguments::getInputFile() {
     if(input) return std::move(*input);
     throw ArgumentException("No valid input file");
 }
-void MainArguments::addCallbacks(hart::Hart& hart, elf::File& elf) {
-
-    bool useColor = this->useColor();
-    auto elf_symbols = elf.getSymbolTable();
-
-    if(program_args.get<bool>("--inst")) {
-        if(program_args.get<bool>("--syms")) {
-            hart.addBeforeExecuteListener([this,
-                                           useColor,
-
-                                           elf_symbols](hart::HartState& hs) {
-                auto inst = hs().getInstWord();
-                *this->inst_log
-                    << "PC[" << colorAddr(useColor)
-                    << common::Format::doubleword << hs().pc
-                    << colorReset(useColor) << "] = " << colorHex(useColor)
-                    << common::Format::word << inst << colorReset(useColor)
-                    << "; " << isa::inst::disassemble(inst, hs().pc, useColor);
-                auto it = elf_symbols.find(uint64_t(hs().pc));
-                if(it != elf_symbols.end()) {
-                    *this->inst_log << " <" << colorSym(useColor) << it->second
-                                    << colorReset(useColor) << ">";
+std::ostream& MainArguments::printRecord(const trace::Record& r) {
+    bool useColor = trace_color;
+    switch(r.kind) {
+        case trace::Record::Kind::INST: {
+            *inst_log << "PC[" << colorAddr(useColor)
+                      << common::Format::doubleword << r.addr
+                      << colorReset(useColor) << "] = " << colorHex(useColor)
+                      << common::Format::word << r.id << colorReset(useColor)
+                      << "; " << isa::inst::disassemble(r.id, r.addr, useColor);
+            if(trace_symbols) {
+                auto it = trace_symbols->find(r.addr);
+                if(it != trace_symbols->end()) {
+                    *inst_log << " <" << colorSym(useColor) << it->second
+                              << colorReset(useColor) << ">";
                 }
-                *this->inst_log << std::endl;
-            });
-        } else {
-            hart.addBeforeExecuteListener([this,
-                                           useColor](hart::HartState& hs) {
-                auto inst = hs().getInstWord();
-                *this->inst_log
-                    << "PC[" << colorAddr(useColor)
-                    << common::Format::doubleword << hs().pc
-                    << colorReset(useColor) << "] = " << colorHex(useColor)
-                    << common::Format::word << inst << colorReset(useColor)
-                    << "; " << isa::inst::disassemble(inst, hs().pc, useColor)
-                    << std::endl;
-            });
+            }
+            return *inst_log;
         }
+        case trace::Record::Kind::REG_READ:
+            return *reg_log << "RD " << RegisterClass::getClassName(r.id)
+                            << "[" << colorAddr(useColor) << common::Format::dec
+                            << r.addr << colorReset(useColor) << "] = "
+                            << colorNew(useColor) << common::Format::doubleword
+                            << r.value << colorReset(useColor);
+        case trace::Record::Kind::REG_WRITE:
+            return *reg_log << "WR " << RegisterClass::getClassName(r.id)
+                            << "[" << colorAddr(useColor) << common::Format::dec
+                            << r.addr << colorReset(useColor) << "] = "
+                            << colorNew(useColor) << common::Format::doubleword
+                            << r.value << colorReset(useColor)
+                            << "; OLD VALUE = " << colorOld(useColor)
+                            << common::Format::doubleword << r.old_value
+                            << colorReset(useColor);
+        case trace::Record::Kind::ALLOCATION:
+            return *mem_log << "ALLOCATE[" << colorAddr(useColor)
+                            << common::Format::doubleword << r.addr
+                            << colorReset(useColor) << " - "
+                            << colorAddr(useColor) << common::Format::doubleword
+                            << r.addr + r.value << colorReset(useColor) << "]";
+        case trace::Record::Kind::MEM_BLOCK_READ:
+        case trace::Record::Kind::MEM_BLOCK_WRITE: {
+            bool read = r.kind == trace::Record::Kind::MEM_BLOCK_READ;
+            return *mem_log << (read ? "RD" : "WR") << " MEM BLOCK["
+                            << colorAddr(useColor) << common::Format::doubleword
+                            << r.addr << colorReset(useColor) << " - "
+                            << colorAddr(useColor) << common::Format::doubleword
+                            << r.addr + r.value << colorReset(useColor) << "]";
+        }
+        case trace::Record::Kind::MEM_READ:
+            if(trace_csv) {
+                *mem_log << "rd-mem," << r.addr << ",";
+                if(r.size == 1) *mem_log << (uint8_t)r.value;
+                else if(r.size == 2) *mem_log << (uint16_t)r.value;
+                else if(r.size == 4) *mem_log << (uint32_t)r.value;
+                else *mem_log << r.value;
+                return *mem_log;
+            }
+            return *mem_log << "RD MEM[" << colorAddr(useColor)
+                            << common::Format::doubleword << r.addr
+                            << colorReset(useColor) << "] = "
+                            << colorNew(useColor)
+                            << common::Format::hexnum(r.size) << r.value
+                            << colorReset(useColor);
+        case trace::Record::Kind::MEM_WRITE:
+            if(trace_csv) {
+                *mem_log << "wr-mem," << r.addr << ",";
+                // need extra casts so that cout doesn't try and interpret
+                // as a char
+                if(r.size == 1) *mem_log << (uint64_t)(uint8_t)r.value;
+                else if(r.size == 2) *mem_log << (uint64_t)(uint16_t)r.value;
+                else if(r.size == 4) *mem_log << (uint64_t)(uint32_t)r.value;
+                else *mem_log << r.value;
+                return *mem_log;
+            }
+            return *mem_log << "WR MEM[" << colorAddr(useColor)
+                            << common::Format::doubleword << r.addr
+                            << colorReset(useColor) << "] = "
+                            << colorNew(useColor)
+                            << common::Format::hexnum(r.size) << r.value
+                            << colorReset(useColor)
+                            << "; OLD VALUE = " << colorOld(useColor)
+                            << common::Format::hexnum(r.size) << r.old_value
+                            << colorReset(useColor);
+    }
+    return std::cout;
+}
+
+void MainArguments::emit(const trace::Record& r) {
+    if(async_trace) async_trace->push(r);
+    else printRecord(r) << std::endl;
+}
+
+void MainArguments::addCallbacks(hart::Hart& hart, elf::File& elf) {
+    using Kind = trace::Record::Kind;
+
+    trace_color = this->useColor();
+    trace_csv = program_args.get<bool>("--csv");
+    if(program_args.get<bool>("--syms")) {
+        trace_symbols =
+            std::make_shared<const std::unordered_map<uint64_t, std::string>>(
+                elf.getSymbolTable());
     }
 
-    if(program_args.get<bool>("--reg")) {
-        hart.addRegisterReadListener(
-            [this,
-             useColor](std::string classname, uint64_t idx, uint64_t value) {
-                *this->reg_log << "RD " << classname << "["
-                               << colorAddr(useColor) << common::Format::dec
-                               << idx << colorReset(useColor)
-                               << "] = " << colorNew(useColor)
-                               << common::Format::doubleword << (uint64_t)value
-                               << colorReset(useColor) << std::endl;
+    bool inst = program_args.get<bool>("--inst");
+    bool reg = program_args.get<bool>("--reg");
+    bool mem = program_args.get<bool>("--mem");
+    if(program_args.get<bool>("--async-trace") && (inst || reg || mem)) {
+        // the consumer only writes a newline per record and flushes once it
+        // has caught up, instead of flushing every line
+        async_trace = std::make_shared<trace::AsyncTrace>(
+            [this](const trace::Record& r) { printRecord(r) << "\n"; },
+            [this]() {
+                inst_log->flush();
+                reg_log->flush();
+                mem_log->flush();
             });
-        hart.addRegisterWriteListener([this, useColor](
-                                          std::string classname,
-                                          uint64_t idx,
-                                          uint64_t value,
-                                          uint64_t oldvalue) {
-            *this->reg_log << "WR " << classname << "[" << colorAddr(useColor)
-                           << common::Format::dec << idx << colorReset(useColor)
-                           << "] = " << colorNew(useColor)
-                           << common::Format::doubleword << (uint64_t)value
-                           << colorReset(useColor)
-                           << "; OLD VALUE = " << colorOld(useColor)
-                           << common::Format::doubleword << oldvalue
-                           << colorReset(useColor) << std::endl;
-        });
     }
-    if(program_args.get<bool>("--mem")) {
-        if(!program_args.get<bool>("--csv")) {
-            hart.hs().mem().addAllocationListener(
-                [this, useColor](uint64_t addr, uint64_t size) {
-                    *this->mem_log << "ALLOCATE[" << colorAddr(useColor)
-                                   << common::Format::doubleword << addr
-                                   << colorReset(useColor) << " - "
-                                   << colorAddr(useColor)
-                                   << common::Format::doubleword << addr + size
-                                   << colorReset(useColor) << "]" << std::endl;
-                });
-
-            hart.hs().mem().addReadListener(
-                [this, useColor](uint64_t addr, uint64_t value, size_t size) {
-                    *this->mem_log
-                        << "RD MEM[" << colorAddr(useColor)
-                        << common::Format::doubleword << addr
-                        << colorReset(useColor) << "] = " << colorNew(useColor)
-                        << common::Format::hexnum(size) << (uint64_t)value
-                        << colorReset(useColor) << std::endl;
-                });
-            hart.hs().mem().addWriteListener([this, useColor](
-                                                 uint64_t addr,
-                                                 uint64_t value,
-                                                 uint64_t oldvalue,
-                                                 size_t size) {
-                *this->mem_log
-                    << "WR MEM[" << colorAddr(useColor)
-                    << common::Format::doubleword << addr
-                    << colorReset(useColor) << "] = " << colorNew(useColor)
-                    << common::Format::hexnum(size) << (uint64_t)value
-                    << colorReset(useColor)
-                    << "; OLD VALUE = " << colorOld(useColor)
-                    << common::Format::hexnum(size) << oldvalue
-                    << colorReset(useColor) << std::endl;
+
+    if(inst) {
+        auto trace = [this](hart::HartState& hs) {
+            emit({Kind::INST, 0, hs().getInstWord(), hs().pc, 0, 0});
+        };
+        if(trace_opcodes.empty()) hart.addBeforeExecuteListener(trace);
+        else hart.addBeforeExecuteListener(trace_opcodes, trace);
+    }
+
+    if(reg) {
+        auto read = [this](
+                        RegisterClass::ClassID rc,
+                        uint64_t idx,
+                        uint64_t value) {
+            emit({Kind::REG_READ, 0, uint32_t(rc), idx, value, 0});
+        };
+        auto write = [this](
+                         RegisterClass::ClassID rc,
+                         uint64_t idx,
+                         uint64_t value,
+                         uint64_t oldvalue) {
+            emit({Kind::REG_WRITE, 0, uint32_t(rc), idx, value, oldvalue});
+        };
+        if(trace_registers.empty()) {
+            hart.addRegisterReadListener(read);
+            hart.addRegisterWriteListener(write);
+        }
+        for(auto [rct, mask] : trace_registers) {
+            hart.addRegisterReadListener(rct, mask, read);
+            hart.addRegisterWriteListener(rct, mask, write);
+        }
+    }
+    if(mem) {
+        auto& m = hart.hs().mem();
+        auto read = [this](uint64_t addr, uint64_t value, size_t size) {
+            emit({Kind::MEM_READ, uint8_t(size), 0, addr, value, 0});
+        };
+        auto write = [this](
+                         uint64_t addr,
+                         uint64_t value,
+                         uint64_t oldvalue,
+                         size_t size) {
+            emit({Kind::MEM_WRITE, uint8_t(size), 0, addr, value, oldvalue});
+        };
+        if(!trace_csv) {
+            m.addAllocationListener([this](uint64_t addr, uint64_t size) {
+                if(trace_ranges.empty() || trace_ranges.overlaps(addr, size))
+                    emit({Kind::ALLOCATION, 0, 0, addr, size, 0});
             });
+        }
+        if(trace_ranges.empty()) {
+            m.addReadListener(read);
+            m.addWriteListener(write);
         } else {
-            hart.hs().mem().addReadListener(
-                [this](uint64_t addr, uint64_t value, size_t size) {
-                    *this->mem_log << "rd-mem," << addr << ",";
-                    if(size == 1) *this->mem_log << (uint8_t)value;
-                    else if(size == 2) *this->mem_log << (uint16_t)value;
-                    else if(size == 4) *this->mem_log << (uint32_t)value;
-                    else *this->mem_log << value;
-                    *this->mem_log << std::endl;
-                });
-            hart.hs().mem().addWriteListener(
-                [this](
-                    uint64_t addr,
-                    uint64_t value,
-                    [[maybe_unused]] uint64_t oldvalue,
-                    size_t size) {
-                    *this->mem_log << "wr-mem," << addr << ",";
-                    // need extra casts so that cout doesn't try and interpret
-                    // as a char
-                    if(size == 1) *this->mem_log << (uint64_t)(uint8_t)value;
-                    else if(size == 2)
-                        *this->mem_log << (uint64_t)(uint16_t)value;
-                    else if(size == 4)
-                        *this->mem_log << (uint64_t)(uint32_t)value;
-                    else *this->mem_log << (uint64_t)value;
-                    *this->mem_log << std::endl;
-                });
+            m.addReadListener(trace_ranges, read);
+            m.addWriteListener(trace_ranges, write);
         }
+        // the csv format has one row per access, so blocks are logged as
+        // the bytes they cover. the events fire once the block is written
+        auto bytes = [this, &m](Kind kind, uint64_t addr, uint64_t size) {
+            mem::MemoryImage::BareView view(m);
+            for(auto a = addr; a < addr + size; a++) {
+                if(trace_ranges.empty() || trace_ranges.overlaps(a, 1))
+                    emit({kind, 1, 0, a, uint8_t(view.byte(a)), 0});
+            }
+        };
+        m.addBlockReadListener([this, bytes](uint64_t addr, uint64_t size) {
+            if(trace_csv) bytes(Kind::MEM_READ, addr, size);
+            else if(trace_ranges.empty() || trace_ranges.overlaps(addr, size))
+                emit({Kind::MEM_BLOCK_READ, 0, 0, addr, size, 0});
+        });
+        m.addBlockWriteListener([this, bytes](uint64_t addr, uint64_t size) {
+            if(trace_csv) bytes(Kind::MEM_WRITE, addr, size);
+            else if(trace_ranges.empty() || trace_ranges.overlaps(addr, size))
+                emit({Kind::MEM_BLOCK_WRITE, 0, 0, addr, size, 0});
+        });
     }
 }
+void MainArguments::finishTracing() {
+    if(async_trace) async_trace->stop();
+}
 void MainArguments::addControllerCallbacks(hart::Hart& hart) {
     bool useColor = this->useColor();
     for(auto a : parsed_commands) {
@@ -6,10 +6,15 @@
 #include "common/ordered_map.h"
 #include "elf/elf.h"
 #include "hart/hart.h"
+#include "mem/address-ranges.h"
+#include "trace/async-trace.h"
 
 #include <exception>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <unordered_map>
 
 namespace arguments {
 
@@ -27,6 +32,8 @@ class MainArguments {
     std::ifstream getInputFile();
     void addCallbacks(hart::Hart& hart, elf::File& elf);
     void addControllerCallbacks(hart::Hart& hart);
+    // write out any trace records still queued, call once the hart is done
+    void finishTracing();
     std::vector<std::string> getArgV();
     common::ordered_map<std::string, std::string> getEnvVars();
 
@@ -44,6 +51,22 @@ class MainArguments {
     std::ostream* mem_log;
     std::ostream* reg_log;
 
+    // state the trace formatting needs, shared with the async trace thread
+    bool trace_color = false;
+    bool trace_csv = false;
+    std::shared_ptr<const std::unordered_map<uint64_t, std::string>>
+        trace_symbols;
+    std::shared_ptr<trace::AsyncTrace> async_trace;
+    // what --mem-range, --reg-filter, and --inst-filter narrow the traces to,
+    // empty to trace everything
+    mem::AddressRanges trace_ranges;
+    std::map<isa::rf::RegisterClassType, RegisterClass::Mask> trace_registers;
+    isa::inst::OpcodeSet trace_opcodes;
+    // format a record without the trailing newline
+    std::ostream& printRecord(const trace::Record& r);
+    // print a record now, or queue it when tracing asynchronously
+    void emit(const trace::Record& r);
+
     std::vector<command::CommandPtr> parsed_commands;
 
   public:
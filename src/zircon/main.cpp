@@ -19,7 +19,20 @@ int main(int argc, const char** argv, const char** envp) {
     }
 
     elf::File elf(args.getInputFile());
-    hart::Hart hart(std::make_shared<mem::MemoryImage>());
+    auto memimg = std::make_shared<mem::MemoryImage>();
+    if(args.accessRawArguments().get<bool>("--flat-memory") &&
+       !memimg->enableFlatBackend()) {
+        std::cerr << "Flat memory is not supported on this host, falling back "
+                     "to separate regions"
+                  << std::endl;
+    }
+    if(args.accessRawArguments().get<bool>("--hugepages") &&
+       !memimg->enableHugePages()) {
+        std::cerr << "Huge pages are not supported on this host, falling back "
+                     "to normal pages"
+                  << std::endl;
+    }
+    hart::Hart hart(memimg);
     elf.buildMemoryImage(hart.hs().mem());
     auto start = elf.getStartAddress();
     hart.hs().setElfSymbols(elf.getSymbolToAddressMap());
@@ -29,8 +42,20 @@ int main(int argc, const char** argv, const char** envp) {
 
     Stats stats;
     if(args.accessRawArguments().get<bool>("--stats")) {
-        hart.addBeforeExecuteListener(
-            [&stats](hart::HartState& hs) { stats.count(hs); });
+        // counting blocks instead of listening to every instruction keeps
+        // the hart on the block path, which is what the host counters are
+        // meant to measure
+        hart.enableInstructionCounts();
+        stats.startHostCounters();
+    }
+
+    bool jit_verify = args.accessRawArguments().get<bool>("--jit-verify");
+    if(args.accessRawArguments().get<bool>("--jit") || jit_verify) {
+        if(!hart.enableJit(jit_verify)) {
+            std::cerr << "The JIT is not supported on this host, falling back "
+                         "to the interpreter"
+                      << std::endl;
+        }
     }
 
     hart.init(args.getArgV(), args.getEnvVars());
@@ -48,8 +73,11 @@ int main(int argc, const char** argv, const char** envp) {
 
     hart.wait_till_done();
     repl.wait_till_done();
+    args.finishTracing();
 
     if(args.accessRawArguments().get<bool>("--stats")) {
+        stats.countInstructions(hart.getInstructionCounts());
+        stats.countMemory(hart.hs().mem());
         std::cout << stats.dump() << std::endl;
     }
 
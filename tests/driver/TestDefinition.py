@@ -497,13 +497,19 @@ class TestInstance:
 
     @classmethod
     def _execute(cls, cmd: List[str], output_file: TestFile = None) -> int:
+        # tests get no input, so a paused simulator stops instead of waiting
+        # on the ishell
         if output_file:
             with output_file("w") as output_fd:
-                p = sp.Popen(cmd, stdout=output_fd, stderr=output_fd)
+                p = sp.Popen(
+                    cmd, stdin=sp.DEVNULL, stdout=output_fd, stderr=output_fd
+                )
                 p.communicate()
                 return p.returncode
         else:
-            p = sp.Popen(cmd, stdout=sp.DEVNULL, stderr=sp.DEVNULL)
+            p = sp.Popen(
+                cmd, stdin=sp.DEVNULL, stdout=sp.DEVNULL, stderr=sp.DEVNULL
+            )
             p.communicate()
             return p.returncode
 
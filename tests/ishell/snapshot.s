@@ -0,0 +1,26 @@
+# a snapshot is taken before the digit is changed. at the end the shell
+# prints the page that differs and puts the digit back, so the program
+# prints the digit it started with. s1 tells the shell where the program is,
+# each value holds for one instruction
+.section .data
+digit:
+.ascii "0\n"
+
+.section .text
+.global _start
+_start:
+    li s1, 1
+    li s1, 0
+    li t0, '1'
+    la a1, digit
+    sb t0, 0(a1)
+    li s1, 2
+    li s1, 0
+    li a0, 1
+    la a1, digit
+    li a2, 2
+    li a7, 64
+    ecall
+    li a0, 0
+    li a7, 93
+    ecall
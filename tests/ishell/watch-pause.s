@@ -0,0 +1,31 @@
+.section .data
+.global value
+value:
+.dword 0
+before:
+.ascii "before\n"
+after:
+.ascii "after\n"
+
+.section .text
+.global _start
+_start:
+    li a0, 1
+    la a1, before
+    li a2, 7
+    li a7, 64
+    ecall
+    # the watch pauses here, and the shell stops the hart when it has no
+    # input. so the write below must never run, even though it is in the
+    # same block as the store
+    la a1, value
+    li t0, 1
+    sd t0, 0(a1)
+    li a0, 1
+    la a1, after
+    li a2, 6
+    li a7, 64
+    ecall
+    li a0, 0
+    li a7, 93
+    ecall
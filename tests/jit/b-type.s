@@ -0,0 +1,84 @@
+# runs the B-type instructions both taken and not taken enough times to be
+# compiled, with --jit-verify checking every native block against the
+# interpreter
+.section .data
+buffer:
+.space 17
+
+.section .text
+.global _start
+_start:
+    li s0, 0
+    li s1, 0x9e3779b97f4a7c15
+    li s3, 100
+1:
+    li t0, 6364136223846793005
+    mul s1, s1, t0
+    li t0, 1442695040888963407
+    add s1, s1, t0
+    # compare against a value that is sometimes equal and differs in sign
+    srai t1, s1, 60
+    srli t2, s1, 62
+    slli s0, s0, 1
+
+    beq t1, t2, 2f
+    addi s0, s0, 1
+2:
+    bne t1, t2, 2f
+    addi s0, s0, 2
+2:
+    blt t1, t2, 2f
+    addi s0, s0, 3
+2:
+    bge t1, t2, 2f
+    addi s0, s0, 5
+2:
+    bltu t1, t2, 2f
+    addi s0, s0, 7
+2:
+    bgeu t1, t2, 2f
+    addi s0, s0, 11
+2:
+    # against zero and itself
+    beqz t2, 2f
+    addi s0, s0, 13
+2:
+    blt t1, t1, 2f
+    addi s0, s0, 17
+2:
+    addi s3, s3, -1
+    bnez s3, 1b
+
+    mv a0, s0
+    call print_hex
+    j exit
+
+# prints a0 as 16 hex digits and a newline
+print_hex:
+    la t0, buffer
+    li t1, 16
+1:
+    srli t2, a0, 60
+    addi t2, t2, '0'
+    li t3, '9'
+    ble t2, t3, 2f
+    addi t2, t2, 'a' - '9' - 1
+2:
+    sb t2, 0(t0)
+    slli a0, a0, 4
+    addi t0, t0, 1
+    addi t1, t1, -1
+    bnez t1, 1b
+    li t2, '\n'
+    sb t2, 0(t0)
+    li a0, 1
+    la a1, buffer
+    li a2, 17
+    li a7, 64
+    ecall
+    ret
+
+exit:
+    li a0, 0
+    li a7, 93
+    ecall
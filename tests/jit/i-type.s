@@ -0,0 +1,127 @@
+# runs the I-type instructions, loads and jalr included, enough times to be
+# compiled, with --jit-verify checking every native block against the
+# interpreter
+.section .data
+buffer:
+.space 17
+.balign 8
+table:
+.dword 0x8081828384858687, 0xf0e1d2c3b4a59687, 0x7fff80007fffffff
+.dword 0x0000000100000002, 0xffffffffffffffff, 0x0123456789abcdef
+.dword 0x8000000000000000, 0x00000000deadbeef
+
+.section .text
+.global _start
+_start:
+    li s0, 0
+    li s1, 0x9e3779b97f4a7c15
+    li s3, 100
+1:
+    li t0, 6364136223846793005
+    mul s1, s1, t0
+    li t0, 1442695040888963407
+    add s1, s1, t0
+
+    addi t0, s1, -2048
+    add s0, s0, t0
+    xori t0, s1, 1365
+    xor s0, s0, t0
+    ori t0, s1, -1366
+    add s0, s0, t0
+    andi t0, s1, 2047
+    xor s0, s0, t0
+    slti t0, s1, -5
+    add s0, s0, t0
+    sltiu t0, s1, -5
+    add s0, s0, t0
+    addiw t0, s1, 2047
+    xor s0, s0, t0
+    slli t0, s1, 63
+    add s0, s0, t0
+    srli t0, s1, 17
+    xor s0, s0, t0
+    srai t0, s1, 1
+    add s0, s0, t0
+    slliw t0, s1, 31
+    xor s0, s0, t0
+    srliw t0, s1, 5
+    add s0, s0, t0
+    sraiw t0, s1, 7
+    xor s0, s0, t0
+
+    # load every width and sign from a slot picked by the loop counter
+    andi t1, s3, 7
+    slli t1, t1, 3
+    la t2, table
+    add t2, t2, t1
+    lb t0, 1(t2)
+    add s0, s0, t0
+    lbu t0, 7(t2)
+    xor s0, s0, t0
+    lh t0, 2(t2)
+    add s0, s0, t0
+    lhu t0, 6(t2)
+    xor s0, s0, t0
+    lw t0, 0(t2)
+    add s0, s0, t0
+    lwu t0, 4(t2)
+    xor s0, s0, t0
+    ld t0, 0(t2)
+    add s0, s0, t0
+
+    # rd is also a source, or x0
+    mv t1, s1
+    addi t1, t1, 7
+    add s0, s0, t1
+    addi zero, s1, 1
+    ld zero, 0(t2)
+    add s0, s0, zero
+
+    # jalr through a register, linking into the register it jumps through
+    la t1, 2f
+    mv t2, t1
+    jalr t1, 0(t1)
+2:
+    sub t1, t1, t2
+    add s0, s0, t1
+    la t1, 3f
+    jalr zero, 4(t1)
+3:
+    # skipped by the jalr above
+    addi s0, s0, 1
+    addi s3, s3, -1
+    bnez s3, 1b
+
+    mv a0, s0
+    call print_hex
+    j exit
+
+# prints a0 as 16 hex digits and a newline
+print_hex:
+    la t0, buffer
+    li t1, 16
+1:
+    srli t2, a0, 60
+    addi t2, t2, '0'
+    li t3, '9'
+    ble t2, t3, 2f
+    addi t2, t2, 'a' - '9' - 1
+2:
+    sb t2, 0(t0)
+    slli a0, a0, 4
+    addi t0, t0, 1
+    addi t1, t1, -1
+    bnez t1, 1b
+    li t2, '\n'
+    sb t2, 0(t0)
+    li a0, 1
+    la a1, buffer
+    li a2, 17
+    li a7, 64
+    ecall
+    ret
+
+exit:
+    li a0, 0
+    li a7, 93
+    ecall
@@ -0,0 +1,129 @@
+# runs the R-type instructions enough times to be compiled, with --jit-verify
+# checking every native block against the interpreter
+.section .data
+buffer:
+.space 17
+
+.section .text
+.global _start
+_start:
+    li s0, 0
+    li s1, 0x9e3779b97f4a7c15
+    li s2, 0x0123456789abcdef
+    li s3, 100
+1:
+    # step the inputs. the interpreter does not handle dividing by 0 or
+    # overflowing divides, so the divisor is kept positive and its low word
+    # is never 0 or -1
+    li t0, 6364136223846793005
+    mul s1, s1, t0
+    li t0, 1442695040888963407
+    add s1, s1, t0
+    xor s2, s2, s1
+    srli s4, s2, 1
+    andi s4, s4, -2
+    ori s4, s4, 2
+
+    add t0, s1, s2
+    add s0, s0, t0
+    sub t0, s1, s2
+    xor s0, s0, t0
+    xor t0, s1, s2
+    add s0, s0, t0
+    or t0, s1, s2
+    xor s0, s0, t0
+    and t0, s1, s2
+    add s0, s0, t0
+    slt t0, s1, s2
+    add s0, s0, t0
+    sltu t0, s1, s2
+    add s0, s0, t0
+    sll t0, s1, s2
+    xor s0, s0, t0
+    srl t0, s1, s2
+    add s0, s0, t0
+    sra t0, s1, s2
+    xor s0, s0, t0
+    addw t0, s1, s2
+    add s0, s0, t0
+    subw t0, s1, s2
+    xor s0, s0, t0
+    sllw t0, s1, s2
+    add s0, s0, t0
+    srlw t0, s1, s2
+    xor s0, s0, t0
+    sraw t0, s1, s2
+    add s0, s0, t0
+
+    mul t0, s1, s2
+    xor s0, s0, t0
+    mulw t0, s1, s2
+    add s0, s0, t0
+    mulh t0, s1, s2
+    xor s0, s0, t0
+    mulhsu t0, s1, s2
+    add s0, s0, t0
+    mulhu t0, s1, s2
+    xor s0, s0, t0
+    div t0, s1, s4
+    add s0, s0, t0
+    divu t0, s1, s4
+    xor s0, s0, t0
+    rem t0, s1, s4
+    add s0, s0, t0
+    remu t0, s1, s4
+    xor s0, s0, t0
+    divw t0, s1, s4
+    add s0, s0, t0
+    divuw t0, s1, s4
+    xor s0, s0, t0
+    remw t0, s1, s4
+    add s0, s0, t0
+    remuw t0, s1, s4
+    xor s0, s0, t0
+
+    # rd is also a source, or x0
+    add t1, s1, zero
+    sub t1, t1, s2
+    add s0, s0, t1
+    xor zero, s1, s2
+    mul zero, s1, s2
+    div zero, s1, s4
+    add s0, s0, zero
+
+    addi s3, s3, -1
+    bnez s3, 1b
+
+    mv a0, s0
+    call print_hex
+    j exit
+
+# prints a0 as 16 hex digits and a newline
+print_hex:
+    la t0, buffer
+    li t1, 16
+1:
+    srli t2, a0, 60
+    addi t2, t2, '0'
+    li t3, '9'
+    ble t2, t3, 2f
+    addi t2, t2, 'a' - '9' - 1
+2:
+    sb t2, 0(t0)
+    slli a0, a0, 4
+    addi t0, t0, 1
+    addi t1, t1, -1
+    bnez t1, 1b
+    li t2, '\n'
+    sb t2, 0(t0)
+    li a0, 1
+    la a1, buffer
+    li a2, 17
+    li a7, 64
+    ecall
+    ret
+
+exit:
+    li a0, 0
+    li a7, 93
+    ecall
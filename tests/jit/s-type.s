@@ -0,0 +1,88 @@
+# runs the S-type instructions enough times to be compiled, with --jit-verify
+# checking every native block and the memory it wrote against the interpreter
+.section .data
+buffer:
+.space 17
+.balign 8
+slots:
+.space 64
+
+.section .text
+.global _start
+_start:
+    li s0, 0
+    li s1, 0x9e3779b97f4a7c15
+    li s3, 100
+    la s2, slots
+1:
+    li t0, 6364136223846793005
+    mul s1, s1, t0
+    li t0, 1442695040888963407
+    add s1, s1, t0
+
+    # store every width to a slot picked by the loop counter, partly over
+    # what the last iteration stored
+    andi t1, s3, 7
+    slli t1, t1, 2
+    add t2, s2, t1
+    sd s1, 0(t2)
+    sw s1, 8(t2)
+    srli t0, s1, 16
+    sh t0, 10(t2)
+    srli t0, s1, 40
+    sb t0, 13(t2)
+    sb zero, 1(t2)
+    sd s0, 16(t2)
+
+    ld t0, 0(t2)
+    add s0, s0, t0
+    ld t0, 8(t2)
+    xor s0, s0, t0
+    ld t0, 16(t2)
+    add s0, s0, t0
+
+    addi s3, s3, -1
+    bnez s3, 1b
+
+    # fold in everything left in the slots
+    li t1, 8
+2:
+    ld t0, 0(s2)
+    xor s0, s0, t0
+    addi s2, s2, 8
+    addi t1, t1, -1
+    bnez t1, 2b
+
+    mv a0, s0
+    call print_hex
+    j exit
+
+# prints a0 as 16 hex digits and a newline
+print_hex:
+    la t0, buffer
+    li t1, 16
+1:
+    srli t2, a0, 60
+    addi t2, t2, '0'
+    li t3, '9'
+    ble t2, t3, 2f
+    addi t2, t2, 'a' - '9' - 1
+2:
+    sb t2, 0(t0)
+    slli a0, a0, 4
+    addi t0, t0, 1
+    addi t1, t1, -1
+    bnez t1, 1b
+    li t2, '\n'
+    sb t2, 0(t0)
+    li a0, 1
+    la a1, buffer
+    li a2, 17
+    li a7, 64
+    ecall
+    ret
+
+exit:
+    li a0, 0
+    li a7, 93
+    ecall
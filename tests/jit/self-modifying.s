@@ -0,0 +1,65 @@
+# rewrites an instruction from inside a hot block. the native store exits the
+# block early, and --jit-verify has to accept that rather than replay the
+# store in the interpreter
+.section .data
+buffer:
+.space 17
+
+.section .text
+.global _start
+_start:
+    li s0, 0
+    li s3, 100
+    la s1, patched
+    # addi a0, a0, 0
+    li s2, 0x00050513
+1:
+    # patch the immediate to the loop counter, then run it
+    slli t0, s3, 20
+    or t0, t0, s2
+    sw t0, 0(s1)
+    mv a0, s0
+    jal patched
+    mv s0, a0
+    addi s3, s3, -1
+    bnez s3, 1b
+
+    mv a0, s0
+    call print_hex
+    j exit
+
+# on its own page, so that writing to it does not throw away the loop
+.balign 4096
+patched:
+    addi a0, a0, 0
+    ret
+
+# prints a0 as 16 hex digits and a newline
+print_hex:
+    la t0, buffer
+    li t1, 16
+1:
+    srli t2, a0, 60
+    addi t2, t2, '0'
+    li t3, '9'
+    ble t2, t3, 2f
+    addi t2, t2, 'a' - '9' - 1
+2:
+    sb t2, 0(t0)
+    slli a0, a0, 4
+    addi t0, t0, 1
+    addi t1, t1, -1
+    bnez t1, 1b
+    li t2, '\n'
+    sb t2, 0(t0)
+    li a0, 1
+    la a1, buffer
+    li a2, 17
+    li a7, 64
+    ecall
+    ret
+
+exit:
+    li a0, 0
+    li a7, 93
+    ecall
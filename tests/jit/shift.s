@@ -0,0 +1,86 @@
+# runs the shifts on negative values enough times to be compiled, with
+# --jit-verify checking every native block against the interpreter. the
+# right shifts that are arithmetic must copy the sign bit, and the w forms
+# only shift the low word before sign extending it
+.section .data
+buffer:
+.space 17
+
+.section .text
+.global _start
+_start:
+    li t0, 0xfedcba9876543210
+    li t1, 0x0123456789abcdef
+    # the register shift counts are masked, to 4 here
+    li t2, 0x44
+    li t3, 0x24
+    li t4, 63
+    li s0, 100
+1:
+    srai s1, t0, 4
+    sra s2, t0, t2
+    srli s3, t0, 4
+    sra s4, t0, t4
+    sraiw s5, t1, 4
+    sraw s6, t1, t3
+    srliw s7, t1, 4
+    srlw s8, t1, t3
+    slliw s9, t1, 4
+    sllw s10, t1, t3
+    sraiw s11, t0, 4
+    addi s0, s0, -1
+    bnez s0, 1b
+
+    mv a0, s1
+    call print_hex
+    mv a0, s2
+    call print_hex
+    mv a0, s3
+    call print_hex
+    mv a0, s4
+    call print_hex
+    mv a0, s5
+    call print_hex
+    mv a0, s6
+    call print_hex
+    mv a0, s7
+    call print_hex
+    mv a0, s8
+    call print_hex
+    mv a0, s9
+    call print_hex
+    mv a0, s10
+    call print_hex
+    mv a0, s11
+    call print_hex
+    j exit
+
+# prints a0 as 16 hex digits and a newline
+print_hex:
+    la t5, buffer
+    li t6, 16
+1:
+    srli a1, a0, 60
+    addi a1, a1, '0'
+    li a2, '9'
+    ble a1, a2, 2f
+    addi a1, a1, 'a' - '9' - 1
+2:
+    sb a1, 0(t5)
+    slli a0, a0, 4
+    addi t5, t5, 1
+    addi t6, t6, -1
+    bnez t6, 1b
+    li a1, '\n'
+    sb a1, 0(t5)
+    li a0, 1
+    la a1, buffer
+    li a2, 17
+    li a7, 64
+    ecall
+    ret
+
+exit:
+    li a0, 0
+    li a7, 93
+    ecall
@@ -0,0 +1,73 @@
+# runs the U-type instructions enough times to be compiled, with --jit-verify
+# checking every native block against the interpreter
+.section .data
+buffer:
+.space 17
+
+.section .text
+.global _start
+_start:
+    li s0, 0
+    li s3, 100
+    # auipc results depend on where the program is loaded, so only their
+    # distance from here is added in
+    auipc s1, 0
+1:
+    lui t0, 0x80000
+    add s0, s0, t0
+    lui t0, 0x7ffff
+    xor s0, s0, t0
+    lui t0, 0xfffff
+    add s0, s0, t0
+    lui t0, 1
+    xor s0, s0, t0
+    auipc t0, 0
+    sub t0, t0, s1
+    add s0, s0, t0
+    auipc t0, 0x80000
+    sub t0, t0, s1
+    xor s0, s0, t0
+    auipc t0, 0xfffff
+    sub t0, t0, s1
+    add s0, s0, t0
+    lui zero, 0x12345
+    auipc zero, 1
+    add s0, s0, zero
+    slli t0, s0, 7
+    xor s0, s0, t0
+    addi s3, s3, -1
+    bnez s3, 1b
+
+    mv a0, s0
+    call print_hex
+    j exit
+
+# prints a0 as 16 hex digits and a newline
+print_hex:
+    la t0, buffer
+    li t1, 16
+1:
+    srli t2, a0, 60
+    addi t2, t2, '0'
+    li t3, '9'
+    ble t2, t3, 2f
+    addi t2, t2, 'a' - '9' - 1
+2:
+    sb t2, 0(t0)
+    slli a0, a0, 4
+    addi t0, t0, 1
+    addi t1, t1, -1
+    bnez t1, 1b
+    li t2, '\n'
+    sb t2, 0(t0)
+    li a0, 1
+    la a1, buffer
+    li a2, 17
+    li a7, 64
+    ecall
+    ret
+
+exit:
+    li a0, 0
+    li a7, 93
+    ecall
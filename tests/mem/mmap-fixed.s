@@ -0,0 +1,49 @@
+# a MAP_FIXED mapping over existing memory that the flat backend cannot
+# place, since it is larger than a window. the mmap fails with ENOMEM and
+# the memory that was there stays
+.section .data
+kept:
+.ascii "kept\n"
+failed:
+.ascii "failed\n"
+
+.section .text
+.global _start
+_start:
+    li a0, 0
+    li a1, 4096
+    li a2, 3
+    li a3, 0x22
+    li a4, -1
+    li a5, 0
+    li a7, 222
+    ecall
+    mv s0, a0
+    li t0, 1234
+    sd t0, 0(s0)
+
+    mv a0, s0
+    li a1, 1
+    slli a1, a1, 36
+    li a2, 3
+    li a3, 0x32
+    li a4, -1
+    li a5, 0
+    li a7, 222
+    ecall
+    li t0, -12
+    la a1, failed
+    li a2, 7
+    bne a0, t0, 1f
+    ld t0, 0(s0)
+    li t1, 1234
+    bne t0, t1, 1f
+    la a1, kept
+    li a2, 5
+1:
+    li a0, 1
+    li a7, 64
+    ecall
+    li a0, 0
+    li a7, 93
+    ecall
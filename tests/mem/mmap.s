@@ -0,0 +1,101 @@
+# mremap and mprotect of a mapping with a hole in it, and an mmap hint that is
+# free but outside of what the memory backend can place memory in
+.section .data
+buffer:
+.space 17
+
+.section .text
+.global _start
+_start:
+    # map two pages and unmap the second
+    li a0, 0
+    li a1, 8192
+    li a2, 3
+    li a3, 0x22
+    li a4, -1
+    li a5, 0
+    li a7, 222
+    ecall
+    mv s0, a0
+    li t0, 4096
+    add a0, s0, t0
+    li a1, 4096
+    li a7, 215
+    ecall
+
+    # growing the old mapping has to fault, with or without moving it. prints
+    # -EFAULT twice
+    mv a0, s0
+    li a1, 8192
+    li a2, 16384
+    li a3, 1
+    li a7, 216
+    ecall
+    jal print_hex
+    mv a0, s0
+    li a1, 8192
+    li a2, 16384
+    li a3, 0
+    li a7, 216
+    ecall
+    jal print_hex
+
+    # mprotect needs the whole range mapped. prints -ENOMEM, then 0 for the
+    # page that is still there
+    mv a0, s0
+    li a1, 8192
+    li a2, 1
+    li a7, 226
+    ecall
+    jal print_hex
+    mv a0, s0
+    li a1, 4096
+    li a2, 1
+    li a7, 226
+    ecall
+    jal print_hex
+
+    # the hint is only a hint, so this gets memory somewhere else. prints 1
+    li a0, 1
+    slli a0, a0, 62
+    li a1, 4096
+    li a2, 3
+    li a3, 0x22
+    li a4, -1
+    li a5, 0
+    li a7, 222
+    ecall
+    slt a0, a0, zero
+    xori a0, a0, 1
+    jal print_hex
+    j exit
+
+# prints a0 as 16 hex digits and a newline
+print_hex:
+    la t0, buffer
+    li t1, 16
+1:
+    srli t2, a0, 60
+    addi t2, t2, '0'
+    li t3, '9'
+    ble t2, t3, 2f
+    addi t2, t2, 'a' - '9' - 1
+2:
+    sb t2, 0(t0)
+    slli a0, a0, 4
+    addi t0, t0, 1
+    addi t1, t1, -1
+    bnez t1, 1b
+    li t2, '\n'
+    sb t2, 0(t0)
+    li a0, 1
+    la a1, buffer
+    li a2, 17
+    li a7, 64
+    ecall
+    ret
+
+exit:
+    li a0, 0
+    li a7, 93
+    ecall
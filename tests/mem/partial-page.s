@@ -0,0 +1,40 @@
+# loads from past the end of a heap that ends partway through a page. the
+# host cannot fault on that byte with the flat backend, and it must still be
+# out of bounds
+.section .data
+before:
+.ascii "before\n"
+after:
+.ascii "after\n"
+
+.section .text
+.global _start
+_start:
+    # grow the heap to 16 bytes into the next page, the heap may already
+    # hold something
+    li a0, 0
+    li a7, 214
+    ecall
+    li t0, 4096
+    add s0, a0, t0
+    neg t0, t0
+    and s0, s0, t0
+    addi a0, s0, 16
+    li a7, 214
+    ecall
+
+    li a0, 1
+    la a1, before
+    li a2, 7
+    li a7, 64
+    ecall
+    ld t0, 8(s0)
+    ld t0, 16(s0)
+    li a0, 1
+    la a1, after
+    li a2, 6
+    li a7, 64
+    ecall
+    li a0, 0
+    li a7, 93
+    ecall
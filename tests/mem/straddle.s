@@ -0,0 +1,41 @@
+# stores a doubleword that straddles the end of a heap that ends on a page
+# boundary. the flat backend faults on the second half only, and the store
+# must still be out of bounds as a whole
+.section .data
+before:
+.ascii "before\n"
+after:
+.ascii "after\n"
+
+.section .text
+.global _start
+_start:
+    # grow the heap to the end of the page after its current one, the heap
+    # may already hold something
+    li a0, 0
+    li a7, 214
+    ecall
+    li t0, 4096
+    add s0, a0, t0
+    neg t0, t0
+    and s0, s0, t0
+    mv a0, s0
+    li a7, 214
+    ecall
+
+    li a0, 1
+    la a1, before
+    li a2, 7
+    li a7, 64
+    ecall
+    li t0, -1
+    sd t0, -8(s0)
+    sd t0, -4(s0)
+    li a0, 1
+    la a1, after
+    li a2, 6
+    li a7, 64
+    ecall
+    li a0, 0
+    li a7, 93
+    ecall
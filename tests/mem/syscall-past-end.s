@@ -0,0 +1,83 @@
+# hands syscalls buffers that run past the end of a heap that ends on a page
+# boundary. the host must not touch the bytes past the end, the syscall
+# fails with EFAULT instead and the guest carries on
+.section .data
+fault:
+.ascii "efault\n"
+other:
+.ascii "other\n"
+inside:
+.ascii "inside\n"
+path:
+.ascii "abcd"
+
+.section .text
+.global _start
+_start:
+    # grow the heap to the end of the page after its current one, the heap
+    # may already hold something
+    li a0, 0
+    li a7, 214
+    ecall
+    li t0, 4096
+    add s0, a0, t0
+    neg t0, t0
+    and s0, s0, t0
+    mv a0, s0
+    li a7, 214
+    ecall
+
+    # the last 7 bytes of the heap are fine
+    la a0, inside
+    ld t0, 0(a0)
+    sd t0, -8(s0)
+    li a0, 1
+    addi a1, s0, -8
+    li a2, 7
+    li a7, 64
+    ecall
+
+    # write, one byte too many
+    li a0, 1
+    addi a1, s0, -8
+    li a2, 9
+    li a7, 64
+    ecall
+    call check
+
+    # read into a buffer that runs past the end
+    li a0, 0
+    addi a1, s0, -4
+    li a2, 8
+    li a7, 63
+    ecall
+    call check
+
+    # a path without its nul before the end
+    la a0, path
+    lw t0, 0(a0)
+    sw t0, -4(s0)
+    li a0, -100
+    addi a1, s0, -4
+    li a2, 0
+    li a7, 56
+    ecall
+    call check
+
+    li a0, 0
+    li a7, 93
+    ecall
+
+# prints whether a0 is -EFAULT
+check:
+    li t0, -14
+    la a1, fault
+    li a2, 7
+    beq a0, t0, 1f
+    la a1, other
+    li a2, 6
+1:
+    li a0, 1
+    li a7, 64
+    ecall
+    ret